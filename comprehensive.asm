@@ -1,10 +1,12 @@
 .line 1
 .line 1
 PUSH 0
+.global i 0
 STORE 0
 .line 2
 .line 2
 PUSH 0
+.global ptr 1
 STORE 1
 .line 4
 .line 4
@@ -17,8 +19,7 @@ L0:
 LOAD 0
 .line 6
 PUSH 10000
-CMP
-JZ L1
+JGE L1
 .line 11
 .line 8
 .line 8
@@ -36,9 +37,6 @@ JMP L0
 L1:
 .line 16
 L2:
-.line 14
-PUSH 1
-JZ L3
 .line 16
 .line 15
 .line 15
@@ -50,4 +48,3 @@ ADD
 STORE 0
 JMP L2
 L3:
-HALT
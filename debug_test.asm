@@ -1,10 +1,12 @@
 .line 1
 .line 1
 PUSH 10
+.global a 0
 STORE 0
 .line 2
 .line 2
 PUSH 20
+.global b 1
 STORE 1
 .line 3
 .line 3
@@ -13,9 +15,10 @@ LOAD 0
 .line 3
 LOAD 1
 ADD
-STORE 2
+.global c 2
+DUP
 .line 4
 .line 4
-LOAD 2
+STORE 2
 PRINT
 HALT
@@ -1,19 +1,19 @@
+.line 1
+.line 1
 PUSH 0
+.global x 0
 STORE 0
+.line 5
 L0:
+.line 3
+.line 3
 LOAD 0
+.line 3
 PUSH 0
-SUB
-DUP
-JZ L2
-POP
-PUSH 0
-JMP L3
-L2:
-POP
-PUSH 1
-L3:
-JZ L1
+JNE L1
+.line 5
+.line 4
+.line 4
 PUSH 0
 STORE 0
 JMP L0
@@ -1,6 +1,7 @@
 .line 1
 .line 1
 PUSH 0
+.global i 0
 STORE 0
 .line 4
 L0:
@@ -9,8 +10,7 @@ L0:
 LOAD 0
 .line 2
 PUSH 10000000
-CMP
-JZ L1
+JGE L1
 .line 4
 .line 3
 .line 3
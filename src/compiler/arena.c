@@ -0,0 +1,99 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t used;
+    size_t size;
+    _Alignas(8) char data[];
+};
+
+void *arena_alloc(Arena *a, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    ArenaBlock *b = a->head;
+    if (!b || b->used + size > b->size) {
+        // Oversized requests get a block of their own
+        size_t cap = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        b = malloc(sizeof(ArenaBlock) + cap);
+        if (!b) {
+            perror("arena malloc failed");
+            exit(1);
+        }
+        b->next = a->head;
+        b->used = 0;
+        b->size = cap;
+        a->head = b;
+    }
+    void *p = b->data + b->used;
+    b->used += size;
+    memset(p, 0, size);
+    return p;
+}
+
+void arena_free(Arena *a) {
+    ArenaBlock *b = a->head;
+    while (b) {
+        ArenaBlock *next = b->next;
+        free(b);
+        b = next;
+    }
+    a->head = NULL;
+}
+
+// -- Intern Pool (open addressing, FNV-1a) --
+static Arena string_arena;
+static const char **pool = NULL;
+static size_t pool_capacity = 0;
+static size_t pool_count = 0;
+
+static size_t hash_string(const char *s, size_t len) {
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+static const char **pool_slot(const char **slots, size_t capacity, const char *s, size_t len) {
+    size_t i = hash_string(s, len) & (capacity - 1);
+    while (slots[i] && (strncmp(slots[i], s, len) != 0 || slots[i][len] != '\0')) {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &slots[i];
+}
+
+const char *intern(const char *s) {
+    size_t len = strlen(s);
+    if ((pool_count + 1) * 2 > pool_capacity) {
+        size_t capacity = pool_capacity ? pool_capacity * 2 : 256;
+        const char **slots = calloc(capacity, sizeof(char *));
+        if (!slots) {
+            perror("intern calloc failed");
+            exit(1);
+        }
+        for (size_t i = 0; i < pool_capacity; i++) {
+            if (pool[i]) *pool_slot(slots, capacity, pool[i], strlen(pool[i])) = pool[i];
+        }
+        free(pool);
+        pool = slots;
+        pool_capacity = capacity;
+    }
+
+    const char **slot = pool_slot(pool, pool_capacity, s, len);
+    if (!*slot) {
+        char *copy = arena_alloc(&string_arena, len + 1);
+        memcpy(copy, s, len + 1);
+        *slot = copy;
+        pool_count++;
+    }
+    return *slot;
+}
+
+void intern_free(void) {
+    free(pool);
+    pool = NULL;
+    pool_capacity = pool_count = 0;
+    arena_free(&string_arena);
+}
@@ -0,0 +1,26 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Arena Allocator
+// Bump-pointer allocation out of large blocks. Everything allocated from an
+// arena is released at once by arena_free(); there is no per-object free.
+// The AST and all identifier strings live in arenas for the whole compile.
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;  // Current block (older blocks are chained behind it)
+} Arena;
+
+void *arena_alloc(Arena *a, size_t size);  // Zero-filled, 8-byte aligned
+void arena_free(Arena *a);
+
+// Identifier Intern Pool
+// Returns the canonical copy of `s`: equal strings give the same pointer, so
+// identifiers can be compared with == once interned.
+const char *intern(const char *s);
+void intern_free(void);
+
+#endif
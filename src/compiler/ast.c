@@ -8,55 +8,70 @@
 
 extern int yylineno; // From Lexer
 
-// Helper to safely allocate memory
+Arena ast_arena;
+
+// Nodes come zero-filled from the arena (exits on out-of-memory)
 ASTNode* new_node(NodeType type) {
-    ASTNode *node = (ASTNode*)malloc(sizeof(ASTNode));
-    if (!node) {
-        perror("malloc failed");
-        exit(1);
-    }
+    ASTNode *node = arena_alloc(&ast_arena, sizeof(ASTNode));
     node->type = type;
-    node->left = node->right = node->else_branch = node->next = NULL;
-    node->id = node->op = NULL;
-    node->int_val = 0;
     node->line = yylineno;
     return node;
 }
 
+void ast_free(void) {
+    arena_free(&ast_arena);
+}
+
 ASTNode* create_num(int val) {
     ASTNode *node = new_node(NODE_NUM);
     node->int_val = val;
     return node;
 }
 
-ASTNode* create_var(char *id) {
+ASTNode* create_var(const char *id) {
     ASTNode *node = new_node(NODE_VAR);
-    node->id = strdup(id); // Copy the string "x"
+    node->id = intern(id); // Shared copy of the string "x"
     return node;
 }
 
-ASTNode* create_decl(char *id, ASTNode *expr) {
+ASTNode* create_decl(const char *id, ASTNode *expr) {
     ASTNode *node = new_node(NODE_VAR_DECL);
-    node->id = strdup(id);
+    node->id = intern(id);
     node->left = expr; // The initial value
     return node;
 }
 
-ASTNode* create_assign(char *id, ASTNode *expr) {
+ASTNode* create_assign(const char *id, ASTNode *expr) {
     ASTNode *node = new_node(NODE_ASSIGN);
-    node->id = strdup(id);
+    node->id = intern(id);
     node->left = expr;
     return node;
 }
 
-ASTNode* create_bin_op(char *op, ASTNode *left, ASTNode *right) {
+ASTNode* create_bin_op(BinOp op, ASTNode *left, ASTNode *right) {
     ASTNode *node = new_node(NODE_BIN_OP);
-    node->op = strdup(op);
+    node->op = op;
     node->left = left;
     node->right = right;
     return node;
 }
 
+const char *binop_symbol(BinOp op) {
+    switch (op) {
+        case OP_ADD: return "+";
+        case OP_SUB: return "-";
+        case OP_MUL: return "*";
+        case OP_DIV: return "/";
+        case OP_EQ:  return "==";
+        case OP_NE:  return "!=";
+        case OP_LT:  return "<";
+        case OP_GT:  return ">";
+        case OP_LE:  return "<=";
+        case OP_GE:  return ">=";
+    }
+    return "?";
+}
+
 ASTNode* create_if(ASTNode *cond, ASTNode *then_branch, ASTNode *else_branch) {
     ASTNode *node = new_node(NODE_IF);
     node->left = cond;
@@ -78,10 +93,11 @@ ASTNode* create_block(ASTNode *statements) {
     return node;
 }
 
-ASTNode* create_func(char* name, ASTNode* body) {
+ASTNode* create_func(const char* name, ASTNode* params, ASTNode* body) {
     ASTNode* node = new_node(NODE_FUNC);
-    node->id = strdup(name); 
+    node->id = intern(name); 
     node->left = body;
+    node->right = params;
     return node;
 }
 
@@ -91,10 +107,10 @@ ASTNode* create_return(ASTNode* expr) {
     return node;
 }
 
-ASTNode* create_call(char* name, ASTNode* arg) {
+ASTNode* create_call(const char* name, ASTNode* args) {
     ASTNode* node = new_node(NODE_CALL);
-    node->id = strdup(name);
-    node->left = arg;
+    node->id = intern(name);
+    node->left = args;
     return node;
 }
 
@@ -104,6 +120,36 @@ ASTNode* create_print(ASTNode* expr) {
     return node;
 }
 
+ASTNode* create_expr_stmt(ASTNode* expr) {
+    ASTNode* node = new_node(NODE_EXPR_STMT);
+    node->left = expr;
+    return node;
+}
+
+ASTNode* create_input(void) {
+    return new_node(NODE_INPUT);
+}
+
+ASTNode* create_alloc(ASTNode* size) {
+    ASTNode* node = new_node(NODE_ALLOC);
+    node->left = size;
+    return node;
+}
+
+ASTNode* create_index(ASTNode* array, ASTNode* index) {
+    ASTNode* node = new_node(NODE_INDEX);
+    node->left = array;
+    node->right = index;
+    return node;
+}
+
+ASTNode* create_index_assign(ASTNode* target, ASTNode* value) {
+    ASTNode* node = new_node(NODE_INDEX_ASSIGN);
+    node->left = target;
+    node->right = value;
+    return node;
+}
+
 // Simple recursive printer to see our tree structure
 void print_ast(ASTNode *node, int level) {
     if (!node) return;
@@ -116,7 +162,7 @@ void print_ast(ASTNode *node, int level) {
         case NODE_VAR: printf("VAR: %s\n", node->id); break;
         case NODE_VAR_DECL: printf("DECL: %s\n", node->id); break;
         case NODE_ASSIGN: printf("ASSIGN: %s\n", node->id); break;
-        case NODE_BIN_OP: printf("OP: %s\n", node->op); break;
+        case NODE_BIN_OP: printf("OP: %s\n", binop_symbol(node->op)); break;
         case NODE_IF: printf("IF\n"); break;
         case NODE_WHILE: printf("WHILE\n"); break;
         case NODE_BLOCK: printf("BLOCK\n"); break;
@@ -124,8 +170,14 @@ void print_ast(ASTNode *node, int level) {
         case NODE_RETURN: printf("RETURN\n"); break;
         case NODE_CALL: printf("CALL: %s()\n", node->id); break;
         case NODE_PRINT: printf("PRINT\n"); break;
+        case NODE_EXPR_STMT: printf("EXPR\n"); break;
+        case NODE_INPUT: printf("INPUT\n"); break;
+        case NODE_ALLOC: printf("ALLOC\n"); break;
+        case NODE_INDEX: printf("INDEX\n"); break;
+        case NODE_INDEX_ASSIGN: printf("INDEX ASSIGN\n"); break;
     }
     
+    // Parameters and arguments are lists, printed through `next` below
     print_ast(node->left, level + 1);
     print_ast(node->right, level + 1);
     if (node->else_branch) print_ast(node->else_branch, level + 1);
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "arena.h"
 
 // Enum to identify the type of node
 typedef enum {
@@ -17,24 +18,43 @@ typedef enum {
     NODE_BIN_OP,    // "x + 5" or "x < 10"
     NODE_NUM,       // "10"
     NODE_VAR,      // "x" (using a variable)
-    NODE_FUNC,      // Function Definition "func f() { ... }"
+    NODE_FUNC,      // Function Definition "func f(a, b) { ... }"
     NODE_RETURN,    // Return statement "return x;"
-    NODE_CALL,      // Function call "f()" */
-    NODE_PRINT      // Print statement "print(x);"
+    NODE_CALL,      // Function call "f(1, x)"
+    NODE_PRINT,     // Print statement "print(x);"
+    NODE_EXPR_STMT, // Expression evaluated for its effect "f(x);"
+    NODE_INPUT,     // Read an integer "input()"
+    NODE_ALLOC,     // Heap array "alloc(n)"
+    NODE_INDEX,     // Array element "a[i]"
+    NODE_INDEX_ASSIGN // "a[i] = 5;" (left is the NODE_INDEX, right the value)
 } NodeType;
 
+// Binary Operators (dispatched with a switch in gen())
+typedef enum {
+    OP_ADD,  // +
+    OP_SUB,  // -
+    OP_MUL,  // *
+    OP_DIV,  // /
+    OP_EQ,   // ==
+    OP_NE,   // !=
+    OP_LT,   // <
+    OP_GT,   // >
+    OP_LE,   // <=
+    OP_GE    // >=
+} BinOp;
+
 // The Main Node Structure
 typedef struct ASTNode {
     NodeType type;
     
-    // For Variables (e.g., "x")
-    char *id;
+    // For Variables (e.g., "x"). Interned: compare with ==
+    const char *id;
     
     // For Numbers (e.g., 10)
     int int_val;
     
     // For Binary Ops (e.g., '+', '-', '<')
-    char *op;
+    BinOp op;
     
     // Children (The tree structure)
     struct ASTNode *left;
@@ -47,12 +67,17 @@ typedef struct ASTNode {
     int line;
 } ASTNode;
 
+// All nodes are allocated from this arena; ast_free() releases the whole tree
+extern Arena ast_arena;
+void ast_free(void);
+
 // Function Prototypes (We will implement these in ast.c)
 ASTNode* create_num(int val);
-ASTNode* create_var(char *id);
-ASTNode* create_decl(char *id, ASTNode *expr);
-ASTNode* create_assign(char *id, ASTNode *expr);
-ASTNode* create_bin_op(char *op, ASTNode *left, ASTNode *right);
+ASTNode* create_var(const char *id);
+ASTNode* create_decl(const char *id, ASTNode *expr);
+ASTNode* create_assign(const char *id, ASTNode *expr);
+ASTNode* create_bin_op(BinOp op, ASTNode *left, ASTNode *right);
+const char *binop_symbol(BinOp op);
 ASTNode* create_if(ASTNode *cond, ASTNode *then_branch, ASTNode *else_branch);
 ASTNode* create_while(ASTNode *cond, ASTNode *body);
 ASTNode* create_block(ASTNode *statements);
@@ -60,9 +85,23 @@ ASTNode* create_block(ASTNode *statements);
 // Helper to print the tree (for debugging)
 void print_ast(ASTNode *node, int level);
 
-ASTNode* create_func(char* name, ASTNode* body);
+// Parameters (NODE_VAR) and call arguments are lists linked through `next`
+ASTNode* create_func(const char* name, ASTNode* params, ASTNode* body);
 ASTNode* create_return(ASTNode* expr);
-ASTNode* create_call(char* name, ASTNode* arg);
+ASTNode* create_call(const char* name, ASTNode* args);
 ASTNode* create_print(ASTNode* expr);
+ASTNode* create_expr_stmt(ASTNode* expr);
+ASTNode* create_input(void);
+// Arrays live on the heap: alloc(n) yields the address of n words and a[i]
+// reads the word at that address + i (bounds are those of the VM's memory)
+ASTNode* create_alloc(ASTNode* size);
+ASTNode* create_index(ASTNode* array, ASTNode* index);
+ASTNode* create_index_assign(ASTNode* target, ASTNode* value);
+
+// Constant folding / algebraic simplification (fold.c). Returns the new statement list.
+ASTNode* fold_constants(ASTNode* program);
+
+// Strength reduction and loop-invariant code motion for `while` (loop.c, -O2)
+ASTNode* optimize_loops(ASTNode* program);
 
 #endif
@@ -2,41 +2,336 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include "ast.h"
+#include "emit.h"
+#include "ir.h"
+#include "opcodes.h"
 
 extern int yyparse();
 extern ASTNode *root;
 
-// -- Symbol Table (Simple Linked List) --
+Emitter *out = NULL; // Backend selected by --emit
+
+// -- Symbol Table (Hash Table + Scope Stack) --
+// Interned identifiers live in an open-addressing hash table (linear probing)
+// and are compared by pointer. Each new
+// declaration is also pushed on a scope stack; a NODE_BLOCK remembers the stack
+// height on entry and on exit removes everything declared above it, handing
+// the memory slots back to a free list so later blocks can reuse them.
+//
+// Top-level variables live in memory[]. Parameters and variables declared in a
+// function are locals: slots of the call frame (LOAD_LOCAL/STORE_LOCAL), so
+// every activation, including recursive ones, gets its own copy. A local
+// shadows an outer variable of the same name until its scope ends.
+#define MEM_SLOTS 1024 // Size of memory[] in the VM (MEM_SIZE in src/vm/vm.c)
+
 typedef struct Symbol {
-    char *name;
-    int addr; // Memory Index
-    struct Symbol *next;
+    const char *name;  // Interned; NULL marks an empty bucket
+    int addr;    // Memory index, or frame slot for locals
+    int local;   // Lives in the frame of function `owner`
+    int owner;   // Function that declared it (0 = top level)
+    int pinned;  // Slot is never reused: a function may touch it at any time
 } Symbol;
 
-Symbol *sym_table = NULL;
-int global_addr_counter = 0;
+typedef struct {
+    const char *name;
+    Symbol shadowed; // Outer symbol hidden by this declaration (name == NULL if none)
+} ScopeEntry;
+
+Symbol *sym_buckets = NULL;
+int sym_capacity = 0;
+int sym_count = 0;
+
+ScopeEntry *scope_stack = NULL; // Declarations in order
+int scope_top = 0, scope_capacity = 0;
+
+int *free_slots = NULL;    // Slots released by finished blocks
+int free_count = 0, free_capacity = 0;
+
+int global_addr_counter = 0; // High-water mark of memory[] slots
+int cur_func = 0;            // Scope owner: function (or inlined body) being generated, 0 = top level
+int cur_frame = 0;           // Function whose frame holds new locals (0 = memory[])
+int func_counter = 0;
+int frame_slots = 0;         // Locals allocated so far in cur_frame
+int inline_ret = -1;         // Label a `return` jumps to inside an inlined body
+int opt_level = 1;           // -O0 / -O1 / -O2
+
+static unsigned hash_name(const char *name) {
+    unsigned h = 2166136261u; // FNV-1a
+    while (*name) h = (h ^ (unsigned char)*name++) * 16777619u;
+    return h;
+}
+
+// Bucket holding `name`, or the empty bucket where it would go
+static Symbol *sym_bucket(const char *name) {
+    unsigned i = hash_name(name) & (sym_capacity - 1);
+    while (sym_buckets[i].name && sym_buckets[i].name != name) {
+        i = (i + 1) & (sym_capacity - 1);
+    }
+    return &sym_buckets[i];
+}
+
+static void sym_grow() {
+    Symbol *old = sym_buckets;
+    int old_capacity = sym_capacity;
+    sym_capacity = sym_capacity ? sym_capacity * 2 : 64;
+    sym_buckets = calloc(sym_capacity, sizeof(Symbol));
+    if (!sym_buckets) { perror("calloc"); exit(1); }
+    for (int i = 0; i < old_capacity; i++) {
+        if (old[i].name) *sym_bucket(old[i].name) = old[i];
+    }
+    free(old);
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones
+static void sym_remove(Symbol *sym) {
+    unsigned mask = sym_capacity - 1;
+    unsigned hole = sym - sym_buckets;
+    unsigned i = hole;
+    sym_buckets[hole].name = NULL;
+    for (;;) {
+        i = (i + 1) & mask;
+        if (!sym_buckets[i].name) break;
+        unsigned home = hash_name(sym_buckets[i].name) & mask;
+        // Move the entry back if the hole lies between its home bucket and i
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            sym_buckets[hole] = sym_buckets[i];
+            sym_buckets[i].name = NULL;
+            hole = i;
+        }
+    }
+    sym_count--;
+}
+
+// Innermost declaration of `name`, or NULL (no checks, no pinning)
+static Symbol *find_symbol(const char *name) {
+    if (!sym_count) return NULL;
+    Symbol *sym = sym_bucket(name);
+    return sym->name ? sym : NULL;
+}
+
+// Variable visible from the current function, or NULL if undeclared
+Symbol *get_symbol(const char *name) {
+    Symbol *sym = find_symbol(name);
+    if (!sym) return NULL; // Not found
+    if (sym->local && sym->owner != cur_func) {
+        // No closures: a nested function cannot see the enclosing frame
+        fprintf(stderr, "Error: '%s' is a local variable of an enclosing function\n", name);
+        exit(1);
+    }
+    if (!sym->local && cur_frame > 0) sym->pinned = 1; // Global used by a function
+    return sym;
+}
+
+static int alloc_slot() {
+    if (free_count > 0) return free_slots[--free_count];
+    if (global_addr_counter >= MEM_SLOTS) {
+        fprintf(stderr, "Error: Too many live variables (memory has %d slots)\n", MEM_SLOTS);
+        exit(1);
+    }
+    return global_addr_counter++;
+}
+
+// Declares `name` in the current function (or at top level)
+Symbol *add_symbol(const char *name) {
+    if ((sym_count + 1) * 2 > sym_capacity) sym_grow();
+    Symbol *sym = sym_bucket(name);
+    if (sym->name && sym->owner == cur_func) return sym; // Already exists
+
+    if (scope_top == scope_capacity) {
+        scope_capacity = scope_capacity ? scope_capacity * 2 : 64;
+        scope_stack = realloc(scope_stack, scope_capacity * sizeof(ScopeEntry));
+        if (!scope_stack) { perror("realloc"); exit(1); }
+    }
+    ScopeEntry *entry = &scope_stack[scope_top++];
+    entry->name = name;
+    entry->shadowed = *sym; // Empty bucket (name == NULL) unless shadowing
+    if (!sym->name) sym_count++;
+
+    sym->name = name;
+    sym->owner = cur_func;
+    sym->local = cur_frame > 0;
+    sym->pinned = 0;
+    if (sym->local) {
+        sym->addr = frame_slots++;
+    } else {
+        sym->addr = alloc_slot();
+        // Symbol table entry for the debugger (not for inlined copies or
+        // compiler temporaries, whose names start with '$')
+        if (cur_func == 0 && name[0] != '$') out->global(out, name, sym->addr);
+    }
+    return sym;
+}
 
-int get_symbol_addr(char *name) {
-    Symbol *curr = sym_table;
-    while (curr) {
-        if (strcmp(curr->name, name) == 0) {
-            return curr->addr;
+// Drops every declaration made after `mark` and recycles their memory slots
+static void pop_scope(int mark) {
+    while (scope_top > mark) {
+        ScopeEntry *entry = &scope_stack[--scope_top];
+        Symbol *sym = sym_bucket(entry->name);
+        if (!sym->local && !sym->pinned) {
+            if (free_count == free_capacity) {
+                free_capacity = free_capacity ? free_capacity * 2 : 64;
+                free_slots = realloc(free_slots, free_capacity * sizeof(int));
+                if (!free_slots) { perror("realloc"); exit(1); }
+            }
+            free_slots[free_count++] = sym->addr;
         }
-        curr = curr->next;
+        if (entry->shadowed.name) *sym = entry->shadowed; // Outer variable is visible again
+        else sym_remove(sym);
     }
-    return -1; // Not found
 }
 
-int add_symbol(char *name) {
-    if (get_symbol_addr(name) != -1) return get_symbol_addr(name); // Already exists
-    
-    Symbol *new_sym = malloc(sizeof(Symbol));
-    new_sym->name = strdup(name);
-    new_sym->addr = global_addr_counter++;
-    new_sym->next = sym_table;
-    sym_table = new_sym;
-    return new_sym->addr;
+// Reads or writes a variable wherever it lives
+static void emit_load(Symbol *sym) {
+    out->op_arg(out, sym->local ? LOAD_LOCAL : LOAD, sym->addr);
+}
+
+static void emit_store(Symbol *sym) {
+    out->op_arg(out, sym->local ? STORE_LOCAL : STORE, sym->addr);
+}
+
+// Frame slots a function body declares (nested functions get their own frame)
+static int count_locals(ASTNode *n) {
+    if (!n) return 0;
+    switch (n->type) {
+        case NODE_VAR_DECL: return 1;
+        case NODE_IF: return count_locals(n->right) + count_locals(n->else_branch);
+        case NODE_WHILE: return count_locals(n->right);
+        case NODE_BLOCK: {
+            int count = 0;
+            for (ASTNode *s = n->left; s; s = s->next) count += count_locals(s);
+            return count;
+        }
+        default: return 0;
+    }
+}
+
+static int list_length(ASTNode *n) {
+    int count = 0;
+    for (; n; n = n->next) count++;
+    return count;
+}
+
+// -- Function Table --
+// Arity of every function in the program, collected before code generation so
+// calls can come before the definition, plus what the inliner needs to know.
+#define INLINE_MAX_NODES 32 // Largest body (in AST nodes) that is inlined
+
+typedef struct {
+    const char *name; // Interned
+    int params;
+    ASTNode *def;          // The NODE_FUNC
+    const char *no_inline; // Why calls are never inlined, NULL if they may be
+    int frame;             // Parameters + locals: slots an inlined copy needs
+    int size;              // AST nodes in the body
+    // Variables the body uses and the memory[] slot each name had where the
+    // function was defined (-1: not a global there). Filled in by gen().
+    const char **refs;
+    int *ref_addrs;
+    int ref_count;
+    int defined;
+} FuncInfo;
+
+FuncInfo *funcs = NULL;
+int func_count = 0, func_capacity = 0;
+
+static FuncInfo *find_func(const char *name) {
+    for (int i = 0; i < func_count; i++) {
+        if (funcs[i].name == name) return &funcs[i];
+    }
+    return NULL;
+}
+
+// Nodes in a subtree, following statement and argument lists
+static int count_nodes(ASTNode *n) {
+    int count = 0;
+    for (; n; n = n->next) {
+        count += 1 + count_nodes(n->left) + count_nodes(n->right) + count_nodes(n->else_branch);
+    }
+    return count;
+}
+
+// 1 if the subtree contains a node of `type`
+static int contains(ASTNode *n, NodeType type) {
+    for (; n; n = n->next) {
+        if (n->type == type) return 1;
+        if (contains(n->left, type) || contains(n->right, type) || contains(n->else_branch, type)) return 1;
+    }
+    return 0;
+}
+
+static int is_param(ASTNode *params, const char *name) {
+    for (; params; params = params->next) {
+        if (params->id == name) return 1;
+    }
+    return 0;
+}
+
+// Records every variable name the body reads or writes (parameters excluded)
+static void collect_refs(FuncInfo *f, ASTNode *n) {
+    for (; n; n = n->next) {
+        if ((n->type == NODE_VAR || n->type == NODE_ASSIGN) && !is_param(f->def->right, n->id)) {
+            int seen = 0;
+            for (int i = 0; i < f->ref_count && !seen; i++) seen = f->refs[i] == n->id;
+            if (!seen) {
+                f->refs = realloc(f->refs, (f->ref_count + 1) * sizeof(const char *));
+                f->ref_addrs = realloc(f->ref_addrs, (f->ref_count + 1) * sizeof(int));
+                if (!f->refs || !f->ref_addrs) { perror("realloc"); exit(1); }
+                f->refs[f->ref_count] = n->id;
+                f->ref_addrs[f->ref_count++] = -1;
+            }
+        }
+        collect_refs(f, n->left);
+        collect_refs(f, n->right);
+        collect_refs(f, n->else_branch);
+    }
+}
+
+// Inlining candidates are small leaf functions whose locals are all declared
+// at the top of the body, so the copy needs no scoping beyond one flat block
+static void classify_inline(FuncInfo *f) {
+    ASTNode *body = f->def->left;
+    f->size = count_nodes(body);
+    f->frame = f->params + count_locals(body);
+    if (opt_level == 0) f->no_inline = "-O0";
+    else if (contains(body, NODE_CALL)) f->no_inline = "not a leaf function";
+    else if (contains(body, NODE_FUNC)) f->no_inline = "defines a function";
+    else if (f->size > INLINE_MAX_NODES) f->no_inline = "body too large";
+    else {
+        for (ASTNode *s = body->left; s; s = s->next) {
+            if (s->type != NODE_VAR_DECL && contains(s, NODE_VAR_DECL)) f->no_inline = "declares variables in a nested block";
+        }
+    }
+    if (!f->no_inline) collect_refs(f, body);
+}
+
+static void collect_funcs(ASTNode *n) {
+    for (; n; n = n->next) {
+        switch (n->type) {
+            case NODE_FUNC:
+                if (find_func(n->id)) {
+                    fprintf(stderr, "Error: Function '%s' is defined twice\n", n->id);
+                    exit(1);
+                }
+                if (func_count == func_capacity) {
+                    func_capacity = func_capacity ? func_capacity * 2 : 16;
+                    funcs = realloc(funcs, func_capacity * sizeof(FuncInfo));
+                    if (!funcs) { perror("realloc"); exit(1); }
+                }
+                funcs[func_count] = (FuncInfo){ .name = n->id, .params = list_length(n->right), .def = n };
+                classify_inline(&funcs[func_count++]);
+                collect_funcs(n->left);
+                break;
+            case NODE_BLOCK: collect_funcs(n->left); break;
+            case NODE_IF:
+                collect_funcs(n->right);
+                collect_funcs(n->else_branch);
+                break;
+            case NODE_WHILE: collect_funcs(n->right); break;
+            default: break;
+        }
+    }
 }
 
 // -- Label Geneartion --
@@ -45,55 +340,176 @@ int new_label() {
     return label_counter++;
 }
 
+// Generated labels are named L<n>
+static void emit_jump(int opcode, int label) {
+    char name[16];
+    snprintf(name, sizeof(name), "L%d", label);
+    out->op_label(out, opcode, name);
+}
+
+static void place_label(int label) {
+    char name[16];
+    snprintf(name, sizeof(name), "L%d", label);
+    out->label(out, name);
+}
+
 // -- Code Generation --
 
+void gen(ASTNode *node);
+
+// Frame slots that inlined calls inside `n` may need (an upper bound: every
+// candidate call site counts, and its slots are reused once it is done)
+static int inline_slots(ASTNode *n) {
+    int count = 0;
+    for (; n; n = n->next) {
+        if (n->type == NODE_FUNC) continue; // Has its own frame
+        if (n->type == NODE_CALL) {
+            FuncInfo *f = find_func(n->id);
+            if (f && !f->no_inline) count += f->frame;
+        }
+        count += inline_slots(n->left) + inline_slots(n->right) + inline_slots(n->else_branch);
+    }
+    return count;
+}
+
+// NULL if `f` can be inlined here, otherwise the reason it cannot. The copy
+// resolves names at the call site, so each variable the body uses must still
+// mean the global it meant where the function was defined.
+static const char *inline_blocker(FuncInfo *f) {
+    if (f->no_inline) return f->no_inline;
+    if (!f->defined) return "defined after the call";
+    for (int i = 0; i < f->ref_count; i++) {
+        if (f->ref_addrs[i] < 0) continue; // Declared by the body itself
+        Symbol *sym = find_symbol(f->refs[i]);
+        if (!sym || sym->local || sym->addr != f->ref_addrs[i]) return "a variable it uses is shadowed here";
+    }
+    return NULL;
+}
+
+static void store_params(ASTNode *p) {
+    if (!p) return;
+    store_params(p->next); // Last argument is on top
+    emit_store(find_symbol(p->id));
+}
+
+// Expands a call to `f` in place: arguments go into fresh variables of the
+// caller's storage (memory[] at top level, frame slots in a function) and a
+// `return` jumps to the end instead of RET, so no CALL/RET/ENTER/LEAVE remain.
+static void gen_inline(ASTNode *call, FuncInfo *f) {
+    for (ASTNode *arg = call->left; arg; arg = arg->next) gen(arg); // Caller's scope
+
+    int mark = scope_top;
+    int outer_func = cur_func, outer_slots = frame_slots, outer_ret = inline_ret;
+    cur_func = ++func_counter; // Fresh scope: callee names shadow the caller's
+    inline_ret = new_label();
+
+    for (ASTNode *p = f->def->right; p; p = p->next) add_symbol(p->id);
+    store_params(f->def->right);
+    gen(f->def->left); // Body
+    out->op_arg(out, PUSH, 0); // Falling off the end returns 0
+    place_label(inline_ret);
+
+    pop_scope(mark);
+    cur_func = outer_func;
+    frame_slots = outer_slots; // The copy's slots are free again
+    inline_ret = outer_ret;
+}
+
+// Pushes the arguments of `call` left to right, then CALL or TAILCALL
+static void gen_call(ASTNode *call, int opcode) {
+    FuncInfo *f = find_func(call->id);
+    int args = list_length(call->left);
+    if (!f) {
+        fprintf(stderr, "Error: Undefined function '%s'\n", call->id);
+        exit(1);
+    }
+    if (f->params != args) {
+        fprintf(stderr, "Error: Function '%s' takes %d argument(s), %d given\n",
+                call->id, f->params, args);
+        exit(1);
+    }
+
+    if (opt_level > 0) {
+        const char *blocker = inline_blocker(f);
+        if (!blocker) {
+            fprintf(stderr, "Inliner: inlined %s() at line %d (%d nodes)\n", f->name, call->line, f->size);
+            gen_inline(call, f);
+            if (opcode == TAILCALL) {
+                out->op(out, LEAVE);
+                out->op(out, RET);
+            }
+            return;
+        }
+        fprintf(stderr, "Inliner: kept call to %s() at line %d (%s)\n", f->name, call->line, blocker);
+    }
+
+    for (ASTNode *arg = call->left; arg; arg = arg->next) gen(arg);
+    out->op_label(out, opcode, call->id);
+}
+
+// Pushes what an element access adds to the array address and returns the
+// LOADI/STOREI offset: a constant index, or the constant in a[i + c], is the
+// offset itself, saving an ADD (addresses wrap, so the sum is the same)
+static int32_t gen_element(ASTNode *index) {
+    if (index->type == NODE_NUM) return index->int_val;
+    int32_t offset = 0;
+    if (index->type == NODE_BIN_OP && index->right->type == NODE_NUM &&
+        (index->op == OP_ADD || index->op == OP_SUB)) {
+        offset = index->op == OP_ADD ? index->right->int_val : (int32_t)(0u - (uint32_t)index->right->int_val);
+        index = index->left;
+    }
+    gen(index);
+    out->op(out, ADD);
+    return offset;
+}
+
 void gen(ASTNode *node) {
     if (!node) return;
 
     // Emit debug metadata (Line Number)
     if (node->line > 0) {
-        printf(".line %d\n", node->line);
+        out->line(out, node->line);
     }
 
     switch (node->type) {
         case NODE_NUM:
-            printf("PUSH %d\n", node->int_val);
+            out->op_arg(out, PUSH, node->int_val);
             break;
 
         case NODE_VAR: {
-            int addr = get_symbol_addr(node->id);
-            if (addr == -1) {
+            Symbol *sym = get_symbol(node->id);
+            if (!sym) {
                 fprintf(stderr, "Error: Undefined variable '%s'\n", node->id);
                 exit(1);
             }
-            printf("LOAD %d\n", addr);
+            emit_load(sym);
             break;
         }
 
         case NODE_VAR_DECL: {
             // "var x = 5;"
-            int addr = add_symbol(node->id);
+            // The initializer is evaluated before the name is in scope, so
+            // `var x = x;` in a function reads the outer x
             if (node->left) {
                 gen(node->left); // Generate code for initializer
-                printf("STORE %d\n", addr);
             } else {
                 // Initialize to 0 by default? Or just do nothing?
                 // Let's push 0 and store to be safe
-                printf("PUSH 0\n");
-                printf("STORE %d\n", addr);
+                out->op_arg(out, PUSH, 0);
             }
+            emit_store(add_symbol(node->id));
             break;
         }
 
         case NODE_ASSIGN: {
             // "x = 10;"
-            int addr = get_symbol_addr(node->id);
-            if (addr == -1) {
+            Symbol *sym = get_symbol(node->id);
+            if (!sym) {
                 fprintf(stderr, "Error: Undefined variable '%s'\n", node->id);
                 exit(1);
             }
             gen(node->left);
-            printf("STORE %d\n", addr);
+            emit_store(sym);
             break;
         }
 
@@ -101,38 +517,18 @@ void gen(ASTNode *node) {
             gen(node->left);
             gen(node->right);
             
-            if (strcmp(node->op, "+") == 0) printf("ADD\n");
-            else if (strcmp(node->op, "-") == 0) printf("SUB\n");
-            else if (strcmp(node->op, "*") == 0) printf("MUL\n");
-            else if (strcmp(node->op, "/") == 0) printf("DIV\n");
-            else if (strcmp(node->op, "==") == 0) { 
-                 // Equality Synthesis
-                 int l_eq = new_label();
-                 int l_done = new_label();
-
-                 // a == b  <==> (a - b) == 0
-                 // Stack: [a, b]
-                 printf("SUB\n"); 
-                 // Stack: [diff]
-                 
-                 printf("DUP\n");      // Duplicate diff to check it
-                 printf("JZ L%d\n", l_eq);
-                 
-                 // Case: Not Equal (diff != 0)
-                 printf("POP\n");      // Pop the diff
-                 printf("PUSH 0\n");   // Result False
-                 printf("JMP L%d\n", l_done);
-                 
-                 // Case: Equal (diff == 0)
-                 printf("L%d:\n", l_eq);
-                 printf("POP\n");      // Pop the diff (which is 0)
-                 printf("PUSH 1\n");   // Result True
-                 
-                 printf("L%d:\n", l_done);
-            }
-            else if (strcmp(node->op, "<") == 0) printf("CMP\n");
-            else {
-                fprintf(stderr, "Error: Unknown BinOp '%s'\n", node->op);
+            // Every operator is a single instruction; comparisons push 1 or 0
+            switch (node->op) {
+                case OP_ADD: out->op(out, ADD); break;
+                case OP_SUB: out->op(out, SUB); break;
+                case OP_MUL: out->op(out, MUL); break;
+                case OP_DIV: out->op(out, DIV); break;
+                case OP_LT:  out->op(out, CMP); break;
+                case OP_EQ:  out->op(out, EQ); break;
+                case OP_NE:  out->op(out, NE); break;
+                case OP_LE:  out->op(out, LE); break;
+                case OP_GT:  out->op(out, GT); break;
+                case OP_GE:  out->op(out, GE); break;
             }
             break;
         }
@@ -143,40 +539,57 @@ void gen(ASTNode *node) {
 
             gen(node->left); // Condition
             // Assume 0 is False, Non-Zero is True.
-            // CMP returns 1 (True) or 0 (False).
-            // JZ jumps if 0 (False).
+            // Comparisons return 1 (True) or 0 (False).
+            // JZ jumps if 0 (False); the optimizer fuses compare + JZ.
             
-            printf("JZ L%d\n", lbl_else);
+            emit_jump(JZ, lbl_else);
             
             gen(node->right); // Then block
-            printf("JMP L%d\n", lbl_end);
+            emit_jump(JMP, lbl_end);
             
-            printf("L%d:\n", lbl_else);
+            place_label(lbl_else);
             if (node->else_branch) {
                 gen(node->else_branch);
             }
             
-            printf("L%d:\n", lbl_end);
+            place_label(lbl_end);
             break;
         }
 
         case NODE_WHILE: {
             int lbl_start = new_label();
             int lbl_end = new_label();
+            // A constant true condition (folded) needs no test at all
+            int forever = node->left->type == NODE_NUM && node->left->int_val != 0;
 
-            printf("L%d:\n", lbl_start);
-            gen(node->left); // Condition
-            printf("JZ L%d\n", lbl_end);
+            if (opt_level >= 2 && !forever) {
+                // Rotated loop: test once on entry, then at the bottom, so each
+                // iteration runs one conditional jump instead of JZ + JMP
+                gen(node->left); // Condition
+                emit_jump(JZ, lbl_end);
+                place_label(lbl_start);
+                gen(node->right); // Body
+                gen(node->left);  // Condition again
+                emit_jump(JNZ, lbl_start);
+                place_label(lbl_end);
+                break;
+            }
+
+            place_label(lbl_start);
+            if (!forever) {
+                gen(node->left); // Condition
+                emit_jump(JZ, lbl_end);
+            }
             
             gen(node->right); // Body
-            printf("JMP L%d\n", lbl_start);
+            emit_jump(JMP, lbl_start);
             
-            printf("L%d:\n", lbl_end);
+            place_label(lbl_end);
             break;
         }
 
         case NODE_BLOCK: {
-            Symbol *saved_sym_table = sym_table; // Save visibility state
+            int mark = scope_top; // Save visibility state
             
             ASTNode *stmt = node->left;
             while (stmt) {
@@ -184,53 +597,129 @@ void gen(ASTNode *node) {
                 stmt = stmt->next;
             }
             
-            // Restore visibility state (popping block-local variables)
-            // Note: We do NOT reset global_addr_counter so addresses don't collide
-            sym_table = saved_sym_table;
+            // Restore visibility state (popping block-local variables).
+            // Their slots are dead now and get reused by later declarations.
+            pop_scope(mark);
             break;
         }
 
         case NODE_FUNC: {
-            // "func name() { body }"
-            // In Lab 4 ISA, we can use labels.
+            // "func name(a, b) { body }"
+            // Calling convention: the caller pushes the arguments left to right
+            // and CALLs; the callee opens a frame with ENTER, moves the
+            // arguments into locals 0..n-1 and always returns one value.
             // JMP over the function body so we don't execute it linearly
             int lbl_func_end = new_label();
-            printf("JMP L%d\n", lbl_func_end);
+            emit_jump(JMP, lbl_func_end);
             
             // Label for the function
-            printf("%s:\n", node->id);
+            out->func(out, node->id);
+            out->label(out, node->id);
+
+            // What the body's variable names mean here, for inlined copies
+            FuncInfo *f = find_func(node->id);
+            for (int i = 0; i < f->ref_count; i++) {
+                Symbol *sym = find_symbol(f->refs[i]);
+                f->ref_addrs[i] = sym && !sym->local ? sym->addr : -1;
+            }
+            f->defined = 1;
+
+            int mark = scope_top;
+            int outer_func = cur_func, outer_frame = cur_frame, outer_slots = frame_slots;
+            int outer_ret = inline_ret;
+            cur_func = cur_frame = ++func_counter;
+            frame_slots = 0;
+            inline_ret = -1;
+
+            int params = list_length(node->right);
+            for (ASTNode *p = node->right; p; p = p->next) add_symbol(p->id);
+            if (frame_slots != params) {
+                fprintf(stderr, "Error: Duplicate parameter name in function '%s'\n", node->id);
+                exit(1);
+            }
+            out->op_arg(out, ENTER, params + count_locals(node->left) + inline_slots(node->left));
+            for (int i = params - 1; i >= 0; i--) {
+                out->op_arg(out, STORE_LOCAL, i); // Last argument is on top
+            }
+
             gen(node->left); // Body
-            // Assume Void return? If implicit, add RET?
-            // "return" node will generate RET.
-            // Fallback RET just in case
-            printf("RET\n"); 
-            
-            printf("L%d:\n", lbl_func_end);
+
+            // Falling off the end returns 0
+            out->op_arg(out, PUSH, 0);
+            out->op(out, LEAVE);
+            out->op(out, RET); 
+
+            pop_scope(mark); // Parameters and locals
+            cur_func = outer_func;
+            cur_frame = outer_frame;
+            frame_slots = outer_slots;
+            inline_ret = outer_ret;
             
-            // Register function in symbol table?
-            // Wait, CALL instruction takes an ADDRESS (Label).
-            // Assembler handles labels.
-            // So we don't need to put functions in "var" symbol table.
+            place_label(lbl_func_end);
             break;
         }
 
         case NODE_RETURN: {
+            if (inline_ret >= 0) {
+                // Inside an inlined body: leave the value and skip to its end
+                if (node->left) gen(node->left);
+                else out->op_arg(out, PUSH, 0);
+                emit_jump(JMP, inline_ret);
+                break;
+            }
+            if (cur_frame > 0 && node->left && node->left->type == NODE_CALL) {
+                // Tail call: the callee takes over this frame and return address
+                gen_call(node->left, TAILCALL);
+                break;
+            }
             if (node->left) {
                 gen(node->left);
             }
-            printf("RET\n");
+            if (cur_frame > 0) out->op(out, LEAVE); // Pop the frame, keep the value
+            out->op(out, RET);
             break;
         }
 
         case NODE_CALL: {
-            // "name()"
-            printf("CALL %s\n", node->id);
+            // "name(a, b)"
+            gen_call(node, CALL);
+            break;
+        }
+
+        case NODE_EXPR_STMT: {
+            gen(node->left);
+            out->op(out, POP); // Discard the result
             break;
         }
 
         case NODE_PRINT: {
             gen(node->left); // Push expression
-            printf("PRINT\n");
+            out->op(out, PRINT);
+            break;
+        }
+
+        case NODE_INPUT:
+            out->op(out, INPUT); // Pushes the value read
+            break;
+
+        case NODE_ALLOC:
+            gen(node->left); // Size in words
+            out->op(out, ALLOC); // Pushes the address of the first element
+            break;
+
+        case NODE_INDEX: {
+            // "a[i]": one bounds-checked LOADI through the address on the stack
+            gen(node->left);
+            out->op_arg(out, LOADI, gen_element(node->right));
+            break;
+        }
+
+        case NODE_INDEX_ASSIGN: {
+            // "a[i] = v;": address, then value, then STOREI
+            gen(node->left->left);
+            int32_t offset = gen_element(node->left->right);
+            gen(node->right);
+            out->op_arg(out, STOREI, offset);
             break;
         }
 
@@ -241,19 +730,70 @@ void gen(ASTNode *node) {
 
 extern FILE *yyin;
 
+// Usage: compiler [--emit=asm|bin] [-o output] [-O0|-O1|-O2] [source.lang]
+//   --emit=asm (default) prints assembly for bin/asm to stdout (or -o file)
+//   --emit=bin assembles in-process and writes the .bin container directly
+//   -O0 plain translation (best for the debugger), -O1 (default) constant
+//   folding + one round of IR passes, -O2 adds loop optimizations and runs
+//   the IR passes until nothing changes
 int main(int argc, char **argv) {
-    if (argc > 1) {
-        FILE *f = fopen(argv[1], "r");
+    const char *source = NULL;
+    const char *output = NULL;
+    int emit_bin = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--emit=bin") == 0) emit_bin = 1;
+        else if (strcmp(argv[i], "--emit=asm") == 0) emit_bin = 0;
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output = argv[++i];
+        else if (strcmp(argv[i], "-O0") == 0) opt_level = 0;
+        else if (strcmp(argv[i], "-O1") == 0) opt_level = 1;
+        else if (strcmp(argv[i], "-O2") == 0) opt_level = 2;
+        else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [--emit=asm|bin] [-o output] [-O0|-O1|-O2] [source.lang]\n", argv[0]);
+            return 1;
+        }
+        else source = argv[i];
+    }
+
+    if (source) {
+        FILE *f = fopen(source, "r");
         if (!f) {
-            perror(argv[1]);
+            perror(source);
             return 1;
         }
         yyin = f;
     }
+
+    FILE *asm_out = stdout;
+    if (emit_bin) {
+        if (!output) {
+            fprintf(stderr, "Error: --emit=bin needs -o <file.bin>\n");
+            return 1;
+        }
+        out = emitter_binary(output);
+    } else {
+        if (output) {
+            asm_out = fopen(output, "w");
+            if (!asm_out) {
+                perror(output);
+                return 1;
+            }
+        }
+        out = emitter_text(asm_out);
+    }
+    if (out && opt_level > 0) out = emitter_ir(out, opt_level);
+    if (!out) {
+        perror("emitter");
+        return 1;
+    }
+
     fprintf(stderr, "Compiler started...\n");
     if (yyparse() == 0) {
         fprintf(stderr, "Parsing successful.\n");
         if (root) {
+            if (opt_level > 0) root = fold_constants(root);
+            if (opt_level >= 2) root = optimize_loops(root);
+            collect_funcs(root);
             fprintf(stderr, "Root exists. Generating code...\n");
             ASTNode *curr = root;
             // Root is a statement_list
@@ -264,10 +804,20 @@ int main(int argc, char **argv) {
         } else {
              fprintf(stderr, "Root is NULL!\n");
         }
-        printf("HALT\n");
+        out->op(out, HALT);
     } else {
         fprintf(stderr, "Parsing failed.\n");
         return 1;
     }
+
+    int rc = out->finish(out); // The IR emitter still needs the interned names here
+    ast_free();
+    intern_free();
+
+    if (rc != 0) {
+        fprintf(stderr, "Error: could not write %s\n", output ? output : "output");
+        return 1;
+    }
+    if (asm_out != stdout) fclose(asm_out);
     return 0;
 }
@@ -0,0 +1,273 @@
+#include "emit.h"
+#include "opcodes.h"
+#include "bytecode.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_STACK_SIZE 256
+#define DEFAULT_HEAP_SIZE 65536
+
+static const char *mnemonic(int opcode) {
+    switch (opcode) {
+        case PUSH: return "PUSH";   case POP: return "POP";     case DUP: return "DUP";
+        case HALT: return "HALT";   case ADD: return "ADD";     case SUB: return "SUB";
+        case MUL: return "MUL";     case DIV: return "DIV";     case CMP: return "CMP";
+        case EQ: return "EQ";       case NE: return "NE";       case LE: return "LE";
+        case GT: return "GT";       case GE: return "GE";
+        case JMP: return "JMP";     case JZ: return "JZ";       case JNZ: return "JNZ";
+        case JEQ: return "JEQ";     case JNE: return "JNE";     case JLT: return "JLT";
+        case JLE: return "JLE";     case JGT: return "JGT";     case JGE: return "JGE";
+        case STORE: return "STORE"; case LOAD: return "LOAD";   case CALL: return "CALL";
+        case LOADI: return "LOADI"; case STOREI: return "STOREI";
+        case RET: return "RET";     case PRINT: return "PRINT"; case INPUT: return "INPUT";
+        case ALLOC: return "ALLOC";
+        case MEMCPY: return "MEMCPY"; case MEMSET: return "MEMSET"; case MEMCMP: return "MEMCMP";
+        case LOAD_LOCAL: return "LOAD_LOCAL";   case STORE_LOCAL: return "STORE_LOCAL";
+        case ENTER: return "ENTER"; case LEAVE: return "LEAVE"; case TAILCALL: return "TAILCALL";
+        default: return "???";
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Text backend: assembly on a FILE*
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    Emitter base;
+    FILE *out;
+} TextEmitter;
+
+#define TEXT(e) (((TextEmitter *)(e))->out)
+
+static void text_op(Emitter *e, int opcode) { fprintf(TEXT(e), "%s\n", mnemonic(opcode)); }
+static void text_op_arg(Emitter *e, int opcode, int arg) { fprintf(TEXT(e), "%s %d\n", mnemonic(opcode), arg); }
+static void text_op_label(Emitter *e, int opcode, const char *label) { fprintf(TEXT(e), "%s %s\n", mnemonic(opcode), label); }
+static void text_label(Emitter *e, const char *name) { fprintf(TEXT(e), "%s:\n", name); }
+static void text_line(Emitter *e, int line) { fprintf(TEXT(e), ".line %d\n", line); }
+static void text_global(Emitter *e, const char *name, int addr) { fprintf(TEXT(e), ".global %s %d\n", name, addr); }
+static void text_func(Emitter *e, const char *name) { fprintf(TEXT(e), ".func %s\n", name); }
+
+static int text_finish(Emitter *e) {
+    int rc = fflush(TEXT(e)) == 0 ? 0 : -1;
+    free(e);
+    return rc;
+}
+
+Emitter *emitter_text(FILE *out) {
+    TextEmitter *t = calloc(1, sizeof(TextEmitter));
+    if (!t) return NULL;
+    t->base = (Emitter){ text_op, text_op_arg, text_op_label, text_label, text_line, text_global, text_func, text_finish };
+    t->out = out;
+    return &t->base;
+}
+
+// ---------------------------------------------------------------------------
+// Binary backend: assembles into memory, then writes the .bin container.
+// Produces the same bytes bin/asm would for the text backend's output.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint8_t *data;
+    size_t len, cap;
+} Buffer;
+
+static void buf_append(Buffer *b, const void *src, size_t n) {
+    if (b->len + n > b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 256;
+        while (cap < b->len + n) cap *= 2;
+        b->data = realloc(b->data, cap);
+        if (!b->data) { perror("realloc"); exit(1); }
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, src, n);
+    b->len += n;
+}
+
+typedef struct {
+    char *name;       // NULL marks an empty slot
+    int32_t addr;
+    int is_func;
+} BinLabel;
+
+typedef struct {
+    uint32_t offset;  // Operand position in the code buffer
+    char *label;
+} BinPatch;
+
+typedef struct {
+    uint32_t kind;    // SYM_GLOBAL or SYM_LABEL
+    char *name;
+    int32_t value;    // Globals only; labels are resolved in finish
+} BinSymbol;
+
+typedef struct {
+    Emitter base;
+    char *path;
+    Buffer code, lines;
+    int current_line;
+    BinLabel *labels;  // Open-addressing hash table
+    uint32_t label_cap, label_count;
+    BinPatch *patches;
+    int patch_count, patch_cap;
+    BinSymbol *symbols;
+    int symbol_count, symbol_cap;
+} BinEmitter;
+
+#define BIN(e) ((BinEmitter *)(e))
+
+#define GROW(arr, count, cap) do { \
+    if ((count) == (cap)) { \
+        (cap) = (cap) ? (cap) * 2 : 64; \
+        (arr) = realloc((arr), (cap) * sizeof(*(arr))); \
+        if (!(arr)) { perror("realloc"); exit(1); } \
+    } \
+} while (0)
+
+static BinLabel *label_slot(BinLabel *slots, uint32_t cap, const char *name) {
+    uint32_t i = bytecode_checksum((const uint8_t *)name, strlen(name)) & (cap - 1);
+    while (slots[i].name && strcmp(slots[i].name, name) != 0) i = (i + 1) & (cap - 1);
+    return &slots[i];
+}
+
+static BinLabel *label_get(BinEmitter *b, const char *name) {
+    if ((b->label_count + 1) * 2 > b->label_cap) {
+        uint32_t cap = b->label_cap * 2;
+        BinLabel *slots = calloc(cap, sizeof(BinLabel));
+        if (!slots) { perror("calloc"); exit(1); }
+        for (uint32_t i = 0; i < b->label_cap; i++) {
+            if (b->labels[i].name) *label_slot(slots, cap, b->labels[i].name) = b->labels[i];
+        }
+        free(b->labels);
+        b->labels = slots;
+        b->label_cap = cap;
+    }
+    BinLabel *l = label_slot(b->labels, b->label_cap, name);
+    if (!l->name) {
+        l->name = strdup(name);
+        l->addr = -1; // Referenced but not (yet) defined
+        b->label_count++;
+    }
+    return l;
+}
+
+static void bin_instr(BinEmitter *b, int opcode) {
+    if (b->current_line > 0) {
+        LineEntry e = { (int32_t)b->code.len, b->current_line };
+        buf_append(&b->lines, &e, sizeof(e));
+    }
+    uint8_t op = (uint8_t)opcode;
+    buf_append(&b->code, &op, 1);
+}
+
+static void bin_op(Emitter *e, int opcode) { bin_instr(BIN(e), opcode); }
+
+static void bin_op_arg(Emitter *e, int opcode, int arg) {
+    bin_instr(BIN(e), opcode);
+    int32_t v = arg;
+    buf_append(&BIN(e)->code, &v, sizeof(v));
+}
+
+static void bin_op_label(Emitter *e, int opcode, const char *label) {
+    BinEmitter *b = BIN(e);
+    bin_instr(b, opcode);
+    GROW(b->patches, b->patch_count, b->patch_cap);
+    b->patches[b->patch_count++] = (BinPatch){ (uint32_t)b->code.len, label_get(b, label)->name };
+    int32_t placeholder = 0;
+    buf_append(&b->code, &placeholder, sizeof(placeholder));
+}
+
+static void bin_label(Emitter *e, const char *name) {
+    BinEmitter *b = BIN(e);
+    BinLabel *l = label_get(b, name);
+    l->addr = (int32_t)b->code.len;
+    GROW(b->symbols, b->symbol_count, b->symbol_cap);
+    b->symbols[b->symbol_count++] = (BinSymbol){ SYM_LABEL, l->name, 0 };
+}
+
+static void bin_line(Emitter *e, int line) { BIN(e)->current_line = line; }
+
+static void bin_global(Emitter *e, const char *name, int addr) {
+    BinEmitter *b = BIN(e);
+    GROW(b->symbols, b->symbol_count, b->symbol_cap);
+    b->symbols[b->symbol_count++] = (BinSymbol){ SYM_GLOBAL, strdup(name), addr };
+}
+
+static void bin_func(Emitter *e, const char *name) { label_get(BIN(e), name)->is_func = 1; }
+
+static void bin_free(BinEmitter *b) {
+    for (uint32_t i = 0; i < b->label_cap; i++) free(b->labels[i].name);
+    for (int i = 0; i < b->symbol_count; i++) {
+        if (b->symbols[i].kind == SYM_GLOBAL) free(b->symbols[i].name);
+    }
+    free(b->labels);
+    free(b->patches);
+    free(b->symbols);
+    free(b->code.data);
+    free(b->lines.data);
+    free(b->path);
+    free(b);
+}
+
+static int bin_finish(Emitter *e) {
+    BinEmitter *b = BIN(e);
+    int rc = 0;
+
+    // Resolve label operands now that every label has an address
+    for (int i = 0; i < b->patch_count; i++) {
+        BinLabel *l = label_slot(b->labels, b->label_cap, b->patches[i].label);
+        if (l->addr < 0) {
+            fprintf(stderr, "Error: Undefined label '%s'\n", l->name);
+            rc = -1;
+            continue;
+        }
+        memcpy(b->code.data + b->patches[i].offset, &l->addr, sizeof(l->addr));
+    }
+
+    // SYMBOLS: count, entries, then names
+    Buffer syms = {0}, names = {0};
+    uint32_t count = b->symbol_count;
+    buf_append(&syms, &count, sizeof(count));
+    for (int i = 0; i < b->symbol_count; i++) {
+        BinSymbol *s = &b->symbols[i];
+        SymbolEntry entry = { s->kind, s->value, (uint32_t)names.len, (uint32_t)strlen(s->name) };
+        if (s->kind == SYM_LABEL) {
+            BinLabel *l = label_slot(b->labels, b->label_cap, s->name);
+            entry.value = l->addr;
+            if (l->is_func) entry.kind = SYM_FUNC;
+        }
+        buf_append(&syms, &entry, sizeof(entry));
+        buf_append(&names, s->name, entry.name_len);
+    }
+    if (names.len) buf_append(&syms, names.data, names.len);
+
+    if (rc == 0) {
+        BytecodeSection sections[] = {
+            { SECTION_CODE, b->code.data, (uint32_t)b->code.len },
+            { SECTION_LINES, b->lines.data, (uint32_t)b->lines.len },
+            { SECTION_SYMBOLS, syms.data, (uint32_t)syms.len },
+        };
+        rc = bytecode_write(b->path, DEFAULT_STACK_SIZE, DEFAULT_HEAP_SIZE, sections, 3);
+    }
+
+    free(syms.data);
+    free(names.data);
+    bin_free(b);
+    return rc;
+}
+
+Emitter *emitter_binary(const char *path) {
+    BinEmitter *b = calloc(1, sizeof(BinEmitter));
+    if (!b) return NULL;
+    b->base = (Emitter){ bin_op, bin_op_arg, bin_op_label, bin_label, bin_line, bin_global, bin_func, bin_finish };
+    b->path = strdup(path);
+    b->label_cap = 64;
+    b->labels = calloc(b->label_cap, sizeof(BinLabel));
+    if (!b->path || !b->labels) {
+        free(b->path);
+        free(b->labels);
+        free(b);
+        return NULL;
+    }
+    return &b->base;
+}
@@ -0,0 +1,30 @@
+#ifndef EMIT_H
+#define EMIT_H
+
+#include <stdio.h>
+
+// Code Emitter Interface
+// gen() describes the program as a stream of instructions, labels and
+// metadata; a backend decides what to do with it:
+//   - text:   prints assembly for bin/asm (the original, human-readable path)
+//   - binary: assembles in memory and writes a .bin container directly,
+//             resolving labels itself, so no assembler process is needed
+// Opcodes are the values from src/vm/opcodes.h.
+
+typedef struct Emitter Emitter;
+
+struct Emitter {
+    void (*op)(Emitter *e, int opcode);                          // Instruction without operand
+    void (*op_arg)(Emitter *e, int opcode, int arg);             // Instruction with an integer operand
+    void (*op_label)(Emitter *e, int opcode, const char *label); // Instruction whose operand is a label address
+    void (*label)(Emitter *e, const char *name);                 // Defines `name` at the current address
+    void (*line)(Emitter *e, int line);                          // Source line of the following instructions
+    void (*global)(Emitter *e, const char *name, int addr);      // Debug symbol for a global variable
+    void (*func)(Emitter *e, const char *name);                  // Marks label `name` as a function
+    int (*finish)(Emitter *e);                                   // Flushes output and frees the emitter; 0 on success
+};
+
+Emitter *emitter_text(FILE *out);
+Emitter *emitter_binary(const char *path);
+
+#endif
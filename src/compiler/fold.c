@@ -0,0 +1,204 @@
+#include <stdint.h>
+#include "ast.h"
+
+// -- Constant Folding & Algebraic Simplification --
+// Runs between parsing and gen(). Works in place on the arena-allocated tree:
+// a folded expression node is turned into a NODE_NUM and keeps its line.
+//
+//   2*3            -> 6
+//   x+0, x-0, x*1  -> x
+//   x*0            -> 0        (only if x has no side effects)
+//   if (1) A else B -> A,  if (0) A else B -> B,  while (0) S -> removed
+//
+// A dead branch that defines a function stays: functions are callable from
+// anywhere in the program, wherever they are written.
+//
+// Arithmetic wraps like the VM's int32 ops. Anything that would fault at
+// runtime (x/0, INT32_MIN/-1) is left alone so the error still happens.
+
+static int is_const(ASTNode *n, int32_t *val) {
+    if (n && n->type == NODE_NUM) {
+        if (val) *val = n->int_val;
+        return 1;
+    }
+    return 0;
+}
+
+// 1 if evaluating `n` can do more than produce a value: call a function or trap
+static int has_side_effects(ASTNode *n) {
+    if (!n) return 0;
+    switch (n->type) {
+        case NODE_NUM:
+        case NODE_VAR:
+            return 0;
+        case NODE_BIN_OP: {
+            int32_t d;
+            if (n->op == OP_DIV && !(is_const(n->right, &d) && d != 0)) return 1; // May divide by zero
+            return has_side_effects(n->left) || has_side_effects(n->right);
+        }
+        default:
+            return 1; // NODE_CALL, NODE_INPUT, NODE_INDEX (may trap) and anything unexpected
+    }
+}
+
+// 1 if the statements `n` define a function at any depth
+static int defines_func(ASTNode *n) {
+    for (; n; n = n->next) {
+        if (n->type == NODE_FUNC) return 1;
+        if (defines_func(n->left) || defines_func(n->right) || defines_func(n->else_branch)) return 1;
+    }
+    return 0;
+}
+
+// Evaluates `a op b` the way the VM would. Returns 0 if it must stay a runtime op.
+static int eval_binop(BinOp op, int32_t a, int32_t b, int32_t *out) {
+    switch (op) {
+        case OP_ADD: *out = (int32_t)((uint32_t)a + (uint32_t)b); return 1;
+        case OP_SUB: *out = (int32_t)((uint32_t)a - (uint32_t)b); return 1;
+        case OP_MUL: *out = (int32_t)((uint32_t)a * (uint32_t)b); return 1;
+        case OP_DIV:
+            if (b == 0 || (a == INT32_MIN && b == -1)) return 0;
+            *out = a / b;
+            return 1;
+        case OP_EQ: *out = a == b; return 1;
+        case OP_NE: *out = a != b; return 1;
+        case OP_LT: *out = a < b;  return 1;
+        case OP_GT: *out = a > b;  return 1;
+        case OP_LE: *out = a <= b; return 1;
+        case OP_GE: *out = a >= b; return 1;
+    }
+    return 0;
+}
+
+static void make_num(ASTNode *n, int32_t val) {
+    n->type = NODE_NUM;
+    n->int_val = val;
+    n->left = n->right = NULL;
+}
+
+// Replaces `n` by its operand `keep`, preserving n's place in the tree
+static ASTNode *replace_with(ASTNode *n, ASTNode *keep) {
+    keep->next = n->next;
+    return keep;
+}
+
+static ASTNode *fold_expr(ASTNode *n) {
+    if (n && (n->type == NODE_INDEX || n->type == NODE_ALLOC)) {
+        // Not foldable themselves, but a constant index becomes the LOADI offset
+        n->left = fold_expr(n->left);
+        n->right = fold_expr(n->right);
+        return n;
+    }
+    if (n && n->type == NODE_CALL) {
+        // Arguments are a list; replace_with() keeps each one linked
+        ASTNode **link = &n->left;
+        for (; *link; link = &(*link)->next) *link = fold_expr(*link);
+        return n;
+    }
+    if (!n || n->type != NODE_BIN_OP) return n;
+
+    n->left = fold_expr(n->left);
+    n->right = fold_expr(n->right);
+
+    int32_t a, b, v;
+    int lc = is_const(n->left, &a);
+    int rc = is_const(n->right, &b);
+
+    if (lc && rc) {
+        if (eval_binop(n->op, a, b, &v)) make_num(n, v);
+        return n;
+    }
+
+    switch (n->op) {
+        case OP_ADD:
+            if (rc && b == 0) return replace_with(n, n->left);   // x + 0
+            if (lc && a == 0) return replace_with(n, n->right);  // 0 + x
+            break;
+        case OP_SUB:
+            if (rc && b == 0) return replace_with(n, n->left);   // x - 0
+            break;
+        case OP_MUL:
+            if (rc && b == 1) return replace_with(n, n->left);   // x * 1
+            if (lc && a == 1) return replace_with(n, n->right);  // 1 * x
+            if ((rc && b == 0 && !has_side_effects(n->left)) ||
+                (lc && a == 0 && !has_side_effects(n->right))) {
+                make_num(n, 0);                                  // x * 0
+            }
+            break;
+        case OP_DIV:
+            if (rc && b == 1) return replace_with(n, n->left);   // x / 1
+            break;
+        default:
+            break;
+    }
+    return n;
+}
+
+static ASTNode *fold_stmt(ASTNode *n);
+
+// Folds a statement list; statements that fold away are unlinked
+static ASTNode *fold_list(ASTNode *list) {
+    ASTNode *head = NULL;
+    ASTNode **link = &head;
+    while (list) {
+        ASTNode *next = list->next;
+        ASTNode *s = fold_stmt(list);
+        if (s) {
+            *link = s;
+            link = &s->next;
+        }
+        list = next;
+    }
+    *link = NULL;
+    return head;
+}
+
+// Returns the replacement for statement `n` (NULL if it disappears)
+static ASTNode *fold_stmt(ASTNode *n) {
+    int32_t c;
+    switch (n->type) {
+        case NODE_VAR_DECL:
+        case NODE_ASSIGN:
+        case NODE_RETURN:
+        case NODE_PRINT:
+            n->left = fold_expr(n->left);
+            return n;
+
+        case NODE_EXPR_STMT:
+            n->left = fold_expr(n->left);
+            return has_side_effects(n->left) ? n : NULL; // Unused pure value
+
+        case NODE_INDEX_ASSIGN:
+            n->left = fold_expr(n->left);
+            n->right = fold_expr(n->right);
+            return n;
+
+        case NODE_BLOCK:
+        case NODE_FUNC:
+            n->left = fold_list(n->left);
+            return n;
+
+        case NODE_IF:
+            n->left = fold_expr(n->left);
+            if (n->right) n->right = fold_stmt(n->right);
+            if (n->else_branch) n->else_branch = fold_stmt(n->else_branch);
+            if (is_const(n->left, &c) && !defines_func(c ? n->else_branch : n->right)) {
+                ASTNode *taken = c ? n->right : n->else_branch;
+                return taken ? replace_with(n, taken) : NULL;
+            }
+            return n;
+
+        case NODE_WHILE:
+            n->left = fold_expr(n->left);
+            if (is_const(n->left, &c) && c == 0 && !defines_func(n->right)) return NULL; // Body never runs
+            if (n->right) n->right = fold_stmt(n->right);
+            return n;
+
+        default:
+            return fold_expr(n);
+    }
+}
+
+ASTNode *fold_constants(ASTNode *program) {
+    return fold_list(program);
+}
@@ -0,0 +1,387 @@
+#include "ir.h"
+#include "arena.h"
+#include "opcodes.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ---------------------------------------------------------------------------
+// Helpers over the instruction stream. Passes never move entries; they only
+// mark them dead or rewrite them in place, so indices stay valid.
+// ---------------------------------------------------------------------------
+
+// Label name -> index of its IR_LABEL (names are interned, so keyed by pointer)
+typedef struct {
+    const char **keys;
+    int *pos;
+    int capacity;
+} LabelMap;
+
+static unsigned hash_ptr(const void *p) {
+    uintptr_t v = (uintptr_t)p;
+    return (unsigned)((v >> 3) * 2654435761u);
+}
+
+static void label_map_build(LabelMap *m, IRProgram *p) {
+    m->capacity = 16;
+    while (m->capacity < p->count * 2) m->capacity *= 2;
+    m->keys = calloc(m->capacity, sizeof(char *));
+    m->pos = malloc(m->capacity * sizeof(int));
+    if (!m->keys || !m->pos) { perror("label map"); exit(1); }
+    for (int i = 0; i < p->count; i++) {
+        if (p->code[i].kind != IR_LABEL) continue;
+        unsigned h = hash_ptr(p->code[i].label) & (m->capacity - 1);
+        while (m->keys[h] && m->keys[h] != p->code[i].label) h = (h + 1) & (m->capacity - 1);
+        m->keys[h] = p->code[i].label;
+        m->pos[h] = i; // Last definition wins, like the assembler
+    }
+}
+
+static int label_pos(LabelMap *m, const char *name) {
+    unsigned h = hash_ptr(name) & (m->capacity - 1);
+    while (m->keys[h]) {
+        if (m->keys[h] == name) return m->pos[h];
+        h = (h + 1) & (m->capacity - 1);
+    }
+    return -1;
+}
+
+static void label_map_free(LabelMap *m) {
+    free(m->keys);
+    free(m->pos);
+}
+
+static int is_op(IRInstr *in, int opcode) {
+    return in->kind == IR_OP && !in->dead && in->opcode == opcode;
+}
+
+static int is_jump(int opcode) {
+    return opcode == JMP || opcode == JZ || opcode == JNZ || (opcode >= JEQ && opcode <= JGE);
+}
+
+// First live instruction at or after i, looking through labels (where control goes)
+static int next_op(IRProgram *p, int i) {
+    for (; i < p->count; i++) {
+        if (p->code[i].kind == IR_OP && !p->code[i].dead) return i;
+    }
+    return -1;
+}
+
+// First live instruction at or after i in the same basic block, -1 at a label
+static int next_op_in_block(IRProgram *p, int i) {
+    for (; i < p->count; i++) {
+        IRInstr *in = &p->code[i];
+        if (in->kind == IR_LABEL) return -1;
+        if (in->kind == IR_OP && !in->dead) return i;
+    }
+    return -1;
+}
+
+// Ops that neither read memory[] nor leave the block; dead-store scans may step over them
+static int is_memory_neutral(int opcode) {
+    switch (opcode) {
+        case PUSH: case POP: case DUP:
+        case ADD: case SUB: case MUL: case DIV: case CMP:
+        case EQ: case NE: case LE: case GT: case GE:
+        case PRINT: case INPUT:
+        case LOAD: case STORE: // Caller checks the address
+        case LOAD_LOCAL: case STORE_LOCAL:
+            return 1;
+        default: // Includes LOADI/STOREI and MEMCPY/MEMSET/MEMCMP: addresses only known at runtime
+            return 0;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Passes. Each returns the number of changes it made.
+// ---------------------------------------------------------------------------
+
+// Conditional jumps L where L starts with `JMP M`: jump straight to M
+static int pass_thread_jumps(IRProgram *p, LabelMap *labels) {
+    int changes = 0;
+    for (int i = 0; i < p->count; i++) {
+        IRInstr *in = &p->code[i];
+        if (in->kind != IR_OP || in->dead || !is_jump(in->opcode) || !in->label) continue;
+        for (int hops = 0; hops < 16; hops++) { // Bounded: JMP cycles never settle
+            int t = label_pos(labels, in->label);
+            int j = t < 0 ? -1 : next_op(p, t);
+            if (j < 0 || j == i || !is_op(&p->code[j], JMP) || !p->code[j].label) break;
+            if (p->code[j].label == in->label) break;
+            in->label = p->code[j].label;
+            changes++;
+        }
+    }
+    return changes;
+}
+
+// `JMP L` / `JZ L` where L is the next thing executed anyway
+static int pass_jump_to_next(IRProgram *p) {
+    int changes = 0;
+    for (int i = 0; i < p->count; i++) {
+        IRInstr *in = &p->code[i];
+        if (in->kind != IR_OP || in->dead || !in->label || (in->opcode != JMP && in->opcode != JZ)) continue;
+        for (int j = i + 1; j < p->count; j++) {
+            IRInstr *n = &p->code[j];
+            if (n->kind == IR_OP && !n->dead) break;
+            if (n->kind == IR_LABEL && n->label == in->label) {
+                if (in->opcode == JMP) {
+                    in->dead = 1;
+                } else {
+                    in->opcode = POP; // JZ still consumes its condition
+                    in->label = NULL;
+                }
+                changes++;
+                break;
+            }
+        }
+    }
+    return changes;
+}
+
+// Marks every instruction reachable from the entry point or a CALL/TAILCALL target;
+// the rest is removed
+static int pass_unreachable(IRProgram *p, LabelMap *labels) {
+    char *seen = calloc(p->count + 1, 1);
+    int *work = malloc((p->count + 1) * sizeof(int));
+    if (!seen || !work) { perror("unreachable"); exit(1); }
+    int top = 0;
+    if (p->count > 0) work[top++] = 0;
+
+    while (top > 0) {
+        for (int i = work[--top]; i < p->count && !seen[i]; i++) {
+            seen[i] = 1;
+            IRInstr *in = &p->code[i];
+            if (in->kind != IR_OP || in->dead) continue;
+            if (in->label && (is_jump(in->opcode) || in->opcode == CALL || in->opcode == TAILCALL)) {
+                int t = label_pos(labels, in->label);
+                if (t >= 0 && !seen[t]) work[top++] = t;
+            }
+            if (in->opcode == JMP || in->opcode == TAILCALL || in->opcode == RET || in->opcode == HALT) break;
+        }
+    }
+
+    int changes = 0;
+    for (int i = 0; i < p->count; i++) {
+        if (p->code[i].kind == IR_OP && !p->code[i].dead && !seen[i]) {
+            p->code[i].dead = 1;
+            changes++;
+        }
+    }
+    free(seen);
+    free(work);
+    return changes;
+}
+
+// The load that reads what `store` writes (STORE -> LOAD, STORE_LOCAL -> LOAD_LOCAL)
+static int matching_load(int store) {
+    return store == STORE ? LOAD : store == STORE_LOCAL ? LOAD_LOCAL : -1;
+}
+
+// STORE a; LOAD a  ->  DUP; STORE a   (and the same for locals)
+static int pass_store_load(IRProgram *p) {
+    int changes = 0;
+    for (int i = 0; i < p->count; i++) {
+        IRInstr *st = &p->code[i];
+        if (st->kind != IR_OP || st->dead || matching_load(st->opcode) < 0 || !st->has_arg) continue;
+        int j = next_op_in_block(p, i + 1);
+        if (j < 0 || !is_op(&p->code[j], matching_load(st->opcode)) || !p->code[j].has_arg ||
+            p->code[j].arg != st->arg) continue;
+        p->code[j].opcode = st->opcode;
+        st->opcode = DUP;
+        st->has_arg = 0;
+        changes++;
+    }
+    return changes;
+}
+
+// STORE a that is overwritten before the block reads it becomes POP
+static int pass_dead_stores(IRProgram *p) {
+    int changes = 0;
+    for (int i = 0; i < p->count; i++) {
+        IRInstr *st = &p->code[i];
+        if (st->kind != IR_OP || st->dead || matching_load(st->opcode) < 0 || !st->has_arg) continue;
+        int store = st->opcode, load = matching_load(store);
+        for (int j = i + 1; j < p->count; j++) {
+            IRInstr *in = &p->code[j];
+            if (in->kind == IR_LABEL) break;
+            if (in->kind != IR_OP || in->dead) continue;
+            if (!is_memory_neutral(in->opcode)) break; // Jumps, CALL, HALT, ... end the scan
+            if (!in->has_arg || in->arg != st->arg) continue;
+            if (in->opcode == load) break;  // Value is read
+            if (in->opcode == store) {      // Overwritten first
+                st->opcode = POP;
+                st->has_arg = 0;
+                changes++;
+                break;
+            }
+        }
+    }
+    return changes;
+}
+
+// Fused branch taken when comparison `cmp` is true (or false, if `negate`)
+static int fused_branch(int cmp, int negate) {
+    switch (cmp) {
+        case CMP: return negate ? JGE : JLT;
+        case EQ:  return negate ? JNE : JEQ;
+        case NE:  return negate ? JEQ : JNE;
+        case LE:  return negate ? JGT : JLE;
+        case GT:  return negate ? JLE : JGT;
+        case GE:  return negate ? JLT : JGE;
+        default:  return -1;
+    }
+}
+
+// <compare>; JZ L  ->  J<inverse> L      <compare>; JNZ L  ->  J<compare> L
+static int pass_fuse_branches(IRProgram *p) {
+    int changes = 0;
+    for (int i = 0; i < p->count; i++) {
+        IRInstr *cmp = &p->code[i];
+        if (cmp->kind != IR_OP || cmp->dead || fused_branch(cmp->opcode, 0) < 0) continue;
+        int j = next_op_in_block(p, i + 1);
+        if (j < 0) continue;
+        IRInstr *br = &p->code[j];
+        if (!br->label || (br->opcode != JZ && br->opcode != JNZ)) continue;
+        br->opcode = fused_branch(cmp->opcode, br->opcode == JZ);
+        cmp->dead = 1;
+        changes++;
+    }
+    return changes;
+}
+
+// A value pushed and immediately discarded
+static int pass_push_pop(IRProgram *p) {
+    int changes = 0;
+    for (int i = 0; i < p->count; i++) {
+        IRInstr *in = &p->code[i];
+        if (in->kind != IR_OP || in->dead) continue;
+        if (in->opcode != PUSH && in->opcode != LOAD && in->opcode != LOAD_LOCAL && in->opcode != DUP) continue;
+        int j = next_op_in_block(p, i + 1);
+        if (j < 0 || !is_op(&p->code[j], POP)) continue;
+        in->dead = 1;
+        p->code[j].dead = 1;
+        changes += 2;
+    }
+    return changes;
+}
+
+int ir_optimize(IRProgram *p, int level) {
+    if (level <= 0) return 0;
+
+    LabelMap labels;
+    label_map_build(&labels, p);
+
+    int live_before = 0;
+    for (int i = 0; i < p->count; i++) live_before += p->code[i].kind == IR_OP && !p->code[i].dead;
+
+    int changes;
+    do {
+        changes = 0;
+        changes += pass_thread_jumps(p, &labels);
+        changes += pass_jump_to_next(p);
+        changes += pass_unreachable(p, &labels);
+        changes += pass_store_load(p);
+        changes += pass_dead_stores(p);
+        changes += pass_push_pop(p);
+        changes += pass_fuse_branches(p);
+    } while (level >= 2 && changes > 0);
+
+    label_map_free(&labels);
+
+    int live_after = 0;
+    for (int i = 0; i < p->count; i++) live_after += p->code[i].kind == IR_OP && !p->code[i].dead;
+    return live_before - live_after;
+}
+
+// ---------------------------------------------------------------------------
+// IR emitter
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    Emitter base;
+    Emitter *target;
+    int level;
+    IRProgram prog;
+} IREmitter;
+
+#define IR(e) ((IREmitter *)(e))
+
+static IRInstr *ir_append(Emitter *e, IRKind kind) {
+    IRProgram *p = &IR(e)->prog;
+    if (p->count == p->capacity) {
+        p->capacity = p->capacity ? p->capacity * 2 : 256;
+        p->code = realloc(p->code, p->capacity * sizeof(IRInstr));
+        if (!p->code) { perror("realloc"); exit(1); }
+    }
+    IRInstr *in = &p->code[p->count++];
+    memset(in, 0, sizeof(*in));
+    in->kind = kind;
+    return in;
+}
+
+static void ir_op(Emitter *e, int opcode) {
+    ir_append(e, IR_OP)->opcode = opcode;
+}
+
+static void ir_op_arg(Emitter *e, int opcode, int arg) {
+    IRInstr *in = ir_append(e, IR_OP);
+    in->opcode = opcode;
+    in->has_arg = 1;
+    in->arg = arg;
+}
+
+static void ir_op_label(Emitter *e, int opcode, const char *label) {
+    IRInstr *in = ir_append(e, IR_OP);
+    in->opcode = opcode;
+    in->label = intern(label);
+}
+
+static void ir_label(Emitter *e, const char *name) { ir_append(e, IR_LABEL)->label = intern(name); }
+static void ir_line(Emitter *e, int line) { ir_append(e, IR_LINE)->arg = line; }
+
+static void ir_global(Emitter *e, const char *name, int addr) {
+    IRInstr *in = ir_append(e, IR_GLOBAL);
+    in->label = intern(name);
+    in->arg = addr;
+}
+
+static void ir_func(Emitter *e, const char *name) { ir_append(e, IR_FUNC)->label = intern(name); }
+
+static int ir_finish(Emitter *e) {
+    IREmitter *ir = IR(e);
+    Emitter *t = ir->target;
+    IRProgram *p = &ir->prog;
+
+    int removed = ir_optimize(p, ir->level);
+    fprintf(stderr, "Optimizer (-O%d): removed %d instructions\n", ir->level, removed);
+
+    // Replay what survived into the real backend
+    for (int i = 0; i < p->count; i++) {
+        IRInstr *in = &p->code[i];
+        switch (in->kind) {
+            case IR_OP:
+                if (in->dead) break;
+                if (in->label) t->op_label(t, in->opcode, in->label);
+                else if (in->has_arg) t->op_arg(t, in->opcode, in->arg);
+                else t->op(t, in->opcode);
+                break;
+            case IR_LABEL:  t->label(t, in->label); break;
+            case IR_LINE:   t->line(t, in->arg); break;
+            case IR_GLOBAL: t->global(t, in->label, in->arg); break;
+            case IR_FUNC:   t->func(t, in->label); break;
+        }
+    }
+
+    free(p->code);
+    free(ir);
+    return t->finish(t);
+}
+
+Emitter *emitter_ir(Emitter *target, int level) {
+    IREmitter *ir = calloc(1, sizeof(IREmitter));
+    if (!ir) return NULL;
+    ir->base = (Emitter){ ir_op, ir_op_arg, ir_op_label, ir_label, ir_line, ir_global, ir_func, ir_finish };
+    ir->target = target;
+    ir->level = level;
+    return &ir->base;
+}
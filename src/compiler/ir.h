@@ -0,0 +1,51 @@
+#ifndef IR_H
+#define IR_H
+
+#include "emit.h"
+
+// Linear IR and Peephole Optimizer
+// The IR emitter sits between gen() and a real backend. It records every
+// instruction, label and directive, splits the stream into basic blocks,
+// runs the optimization passes and then replays the surviving stream into
+// the target emitter:
+//
+//   - jump threading       JMP/JZ/JNZ to a label that starts with `JMP M` go to M
+//   - unreachable code     instructions no path from the entry (or a CALL) reaches
+//   - jump to next         `JMP L` immediately followed by `L:`
+//   - store/load           `STORE a; LOAD a`  ->  `DUP; STORE a`  (also for locals)
+//   - dead stores          `STORE a` overwritten in the same block before any read
+//   - push/pop             `PUSH n; POP`, `LOAD a; POP`, `DUP; POP`  -> nothing
+//   - branch fusion        `LT; JZ L` -> `JGE L`, `EQ; JNZ L` -> `JEQ L`, ...
+//
+// Optimization levels: 0 = no IR at all (and no constant folding),
+// 1 = one round of every pass, 2 = passes repeated until nothing changes.
+
+typedef enum {
+    IR_OP,      // Instruction: opcode [+ integer operand | label operand]
+    IR_LABEL,   // Label definition
+    IR_LINE,    // .line
+    IR_GLOBAL,  // .global
+    IR_FUNC     // .func
+} IRKind;
+
+typedef struct {
+    IRKind kind;
+    int opcode;
+    int has_arg;        // IR_OP: integer operand present
+    int arg;            // Integer operand, line number or global address
+    const char *label;  // Label operand or name; interned, so compare with ==
+    int dead;           // Removed by a pass
+} IRInstr;
+
+typedef struct {
+    IRInstr *code;
+    int count, capacity;
+} IRProgram;
+
+// Wraps `target`. finish() optimizes at `level`, replays and finishes `target`.
+Emitter *emitter_ir(Emitter *target, int level);
+
+// Runs the passes for `level` in place; returns how many instructions were removed
+int ir_optimize(IRProgram *p, int level);
+
+#endif
@@ -0,0 +1,360 @@
+#include <stdint.h>
+#include <stdio.h>
+#include "ast.h"
+
+// -- Loop Optimizations (-O2) --
+// Runs on the folded tree before gen(). For every `while`, innermost first:
+//
+//   Strength reduction: with an induction variable `i = i + c` (one top-level
+//   statement of the body, the only write to i in the loop), each `i * k` with
+//   loop-invariant k is replaced by a temporary kept in step:
+//     var $s = i * k;  while (...) { ... $s ... i = i + c; $s = $s + c*k; ... }
+//   In this VM a MUL is one dispatch like an ADD, so the rewrite costs 4 ops
+//   per iteration and saves 2 per use: it is only done for 3 or more uses.
+//
+//   Invariant code motion: maximal subexpressions of the condition and body
+//   that only read variables the loop never writes are computed once:
+//     while (i < n * m) { x = x + a * b; }
+//       ->  { var $t0 = n * m; var $t1 = a * b; while (i < $t0) { x = x + $t1; } }
+//
+// The temporaries have names the lexer cannot produce and live in a block
+// around the loop, so their slots are recycled afterwards. Loops that call a
+// function are left alone (the callee may write any global), and nothing that
+// can trap (division by a non-constant, an array element) is moved out, since
+// it would also run when the loop body does not.
+
+#define SR_MIN_USES 3
+
+typedef struct {
+    const char **names;
+    int *writes;
+    int count, cap;
+} WriteSet;
+
+static int temp_counter = 0;
+
+static int write_count(WriteSet *w, const char *name) {
+    for (int i = 0; i < w->count; i++) {
+        if (w->names[i] == name) return w->writes[i];
+    }
+    return 0;
+}
+
+static void add_write(WriteSet *w, const char *name) {
+    for (int i = 0; i < w->count; i++) {
+        if (w->names[i] == name) {
+            w->writes[i]++;
+            return;
+        }
+    }
+    if (w->count == w->cap) {
+        w->cap = w->cap ? w->cap * 2 : 16;
+        w->names = realloc(w->names, w->cap * sizeof(const char *));
+        w->writes = realloc(w->writes, w->cap * sizeof(int));
+        if (!w->names || !w->writes) { perror("realloc"); exit(1); }
+    }
+    w->names[w->count] = name;
+    w->writes[w->count++] = 1;
+}
+
+// Variables assigned or declared anywhere in `n`; *calls is set if it calls a
+// function. A nested function's parameters and locals are its own, and its
+// body only runs through a call, so it is not looked into.
+static void collect_writes(ASTNode *n, WriteSet *w, int *calls) {
+    for (; n; n = n->next) {
+        if (n->type == NODE_FUNC) continue;
+        if (n->type == NODE_ASSIGN || n->type == NODE_VAR_DECL) add_write(w, n->id);
+        if (n->type == NODE_CALL) *calls = 1;
+        collect_writes(n->left, w, calls);
+        collect_writes(n->right, w, calls);
+        collect_writes(n->else_branch, w, calls);
+    }
+}
+
+static int same_expr(ASTNode *a, ASTNode *b) {
+    if (!a || !b) return a == b;
+    if (a->type != b->type) return 0;
+    switch (a->type) {
+        case NODE_NUM: return a->int_val == b->int_val;
+        case NODE_VAR: return a->id == b->id;
+        case NODE_BIN_OP: return a->op == b->op && same_expr(a->left, b->left) && same_expr(a->right, b->right);
+        default: return 0;
+    }
+}
+
+static ASTNode *copy_expr(ASTNode *e) {
+    ASTNode *c;
+    switch (e->type) {
+        case NODE_NUM: c = create_num(e->int_val); break;
+        case NODE_VAR: c = create_var(e->id); break;
+        default: c = create_bin_op(e->op, copy_expr(e->left), copy_expr(e->right)); break;
+    }
+    c->line = e->line;
+    return c;
+}
+
+// Only reads variables the loop never writes, and cannot trap
+static int is_invariant(ASTNode *e, WriteSet *w) {
+    switch (e->type) {
+        case NODE_NUM: return 1;
+        case NODE_VAR: return write_count(w, e->id) == 0;
+        case NODE_BIN_OP:
+            if (e->op == OP_DIV && !(e->right->type == NODE_NUM && e->right->int_val != 0 && e->right->int_val != -1))
+                return 0;
+            return is_invariant(e->left, w) && is_invariant(e->right, w);
+        default:
+            return 0; // Calls and anything new
+    }
+}
+
+static const char *new_temp(const char *prefix) {
+    char name[24];
+    snprintf(name, sizeof(name), "$%s%d", prefix, temp_counter++);
+    return intern(name);
+}
+
+// Turns `e` into a read of `name` in place (keeps its place in any list)
+static void make_var(ASTNode *e, const char *name) {
+    e->type = NODE_VAR;
+    e->id = name;
+    e->left = e->right = e->else_branch = NULL;
+}
+
+// Declarations that go in front of the loop, in order
+typedef struct {
+    ASTNode *head;
+    ASTNode **tail;
+} Prelude;
+
+static const char *prelude_add(Prelude *pre, const char *prefix, ASTNode *expr) {
+    const char *name = new_temp(prefix);
+    ASTNode *decl = create_decl(name, expr);
+    decl->line = expr->line;
+    *pre->tail = decl;
+    pre->tail = &decl->next;
+    return name;
+}
+
+// -- Strength reduction --
+
+// `i * k` or `k * i` with invariant k: returns k, else NULL
+static ASTNode *induction_product(ASTNode *e, const char *iv, WriteSet *w) {
+    if (e->type != NODE_BIN_OP || e->op != OP_MUL) return NULL;
+    if (e->left->type == NODE_VAR && e->left->id == iv && is_invariant(e->right, w)) return e->right;
+    if (e->right->type == NODE_VAR && e->right->id == iv && is_invariant(e->left, w)) return e->left;
+    return NULL;
+}
+
+// Counts (or, if `name` is set, replaces) the products `iv * k` in the
+// subtree, outside nested functions (their `iv` is another variable)
+static int rewrite_products(ASTNode *n, const char *iv, ASTNode *k, WriteSet *w, const char *name) {
+    int uses = 0;
+    for (; n; n = n->next) {
+        if (n->type == NODE_FUNC) continue;
+        ASTNode *factor = induction_product(n, iv, w);
+        if (factor && same_expr(factor, k)) {
+            if (name) make_var(n, name);
+            uses++;
+            continue;
+        }
+        uses += rewrite_products(n->left, iv, k, w, name);
+        uses += rewrite_products(n->right, iv, k, w, name);
+        uses += rewrite_products(n->else_branch, iv, k, w, name);
+    }
+    return uses;
+}
+
+// First product of `iv` by an invariant other than `skip` (already rejected
+// factors) in the subtree outside nested functions, or NULL
+static ASTNode *find_product(ASTNode *n, const char *iv, WriteSet *w, ASTNode **skip, int nskip) {
+    for (; n; n = n->next) {
+        if (n->type == NODE_FUNC) continue;
+        ASTNode *k = induction_product(n, iv, w);
+        int rejected = 0;
+        for (int i = 0; k && i < nskip && !rejected; i++) rejected = same_expr(k, skip[i]);
+        if (k && !rejected) return n;
+        ASTNode *found = find_product(n->left, iv, w, skip, nskip);
+        if (!found) found = find_product(n->right, iv, w, skip, nskip);
+        if (!found) found = find_product(n->else_branch, iv, w, skip, nskip);
+        if (found) return found;
+    }
+    return NULL;
+}
+
+// `i = i + c` / `i = c + i` / `i = i - c`: returns the step (negated for -)
+static int induction_step(ASTNode *s, int32_t *step) {
+    if (s->type != NODE_ASSIGN || s->left->type != NODE_BIN_OP) return 0;
+    ASTNode *e = s->left;
+    if (e->op == OP_ADD && e->left->type == NODE_VAR && e->left->id == s->id && e->right->type == NODE_NUM) {
+        *step = e->right->int_val;
+        return 1;
+    }
+    if (e->op == OP_ADD && e->right->type == NODE_VAR && e->right->id == s->id && e->left->type == NODE_NUM) {
+        *step = e->left->int_val;
+        return 1;
+    }
+    if (e->op == OP_SUB && e->left->type == NODE_VAR && e->left->id == s->id && e->right->type == NODE_NUM) {
+        *step = (int32_t)(0u - (uint32_t)e->right->int_val);
+        return 1;
+    }
+    return 0;
+}
+
+static void strength_reduce(ASTNode *loop, WriteSet *w, Prelude *pre) {
+    if (!loop->right || loop->right->type != NODE_BLOCK) return;
+
+    for (ASTNode *s = loop->right->left; s; s = s->next) {
+        int32_t step;
+        if (!induction_step(s, &step) || write_count(w, s->id) != 1) continue;
+        const char *iv = s->id;
+
+        // One temporary per distinct invariant factor with enough uses
+        ASTNode *skip[16];
+        int nskip = 0;
+        ASTNode *product;
+        while (nskip < 16 && ((product = find_product(loop->left, iv, w, skip, nskip)) ||
+                              (product = find_product(loop->right, iv, w, skip, nskip)))) {
+            ASTNode *k = induction_product(product, iv, w);
+            int uses = rewrite_products(loop->left, iv, k, w, NULL) + rewrite_products(loop->right, iv, k, w, NULL);
+            if (uses < SR_MIN_USES) {
+                skip[nskip++] = k;
+                continue;
+            }
+
+            // var $s = i * k;  and after the increment  $s = $s + step*k;
+            ASTNode *factor = copy_expr(k);
+            const char *name = prelude_add(pre, "s", create_bin_op(OP_MUL, create_var(iv), copy_expr(k)));
+            ASTNode *delta;
+            if (factor->type == NODE_NUM) {
+                delta = create_num((int32_t)((uint32_t)step * (uint32_t)factor->int_val));
+            } else {
+                delta = create_var(prelude_add(pre, "d", create_bin_op(OP_MUL, create_num(step), factor)));
+            }
+            rewrite_products(loop->left, iv, k, w, name);
+            rewrite_products(loop->right, iv, k, w, name);
+
+            ASTNode *update = create_assign(name, create_bin_op(OP_ADD, create_var(name), delta));
+            update->line = s->line;
+            update->next = s->next;
+            s->next = update;
+            add_write(w, name);
+        }
+    }
+}
+
+// -- Invariant code motion --
+
+// Replaces maximal invariant subexpressions of `e` by temporaries
+static ASTNode *hoist_expr(ASTNode *e, WriteSet *w, Prelude *pre) {
+    if (!e) return e;
+    if (e->type == NODE_INDEX) {
+        // The element may be stored to in the loop; its address and index need not
+        e->left = hoist_expr(e->left, w, pre);
+        e->right = hoist_expr(e->right, w, pre);
+        return e;
+    }
+    if (e->type == NODE_BIN_OP) {
+        if (is_invariant(e, w)) {
+            // Reuse a temporary computing the same value
+            for (ASTNode *d = pre->head; d; d = d->next) {
+                if (same_expr(d->left, e)) {
+                    make_var(e, d->id);
+                    return e;
+                }
+            }
+            ASTNode *value = create_bin_op(e->op, e->left, e->right);
+            value->line = e->line;
+            make_var(e, prelude_add(pre, "t", value));
+            return e;
+        }
+        e->left = hoist_expr(e->left, w, pre);
+        e->right = hoist_expr(e->right, w, pre);
+    }
+    return e;
+}
+
+static void hoist_stmts(ASTNode *n, WriteSet *w, Prelude *pre) {
+    for (; n; n = n->next) {
+        switch (n->type) {
+            case NODE_VAR_DECL:
+            case NODE_ASSIGN:
+            case NODE_RETURN:
+            case NODE_PRINT:
+            case NODE_EXPR_STMT:
+                n->left = hoist_expr(n->left, w, pre);
+                break;
+            case NODE_INDEX_ASSIGN:
+                n->left = hoist_expr(n->left, w, pre);
+                n->right = hoist_expr(n->right, w, pre);
+                break;
+            case NODE_IF:
+                n->left = hoist_expr(n->left, w, pre);
+                hoist_stmts(n->right, w, pre);
+                hoist_stmts(n->else_branch, w, pre);
+                break;
+            case NODE_WHILE:
+                n->left = hoist_expr(n->left, w, pre);
+                hoist_stmts(n->right, w, pre);
+                break;
+            case NODE_BLOCK:
+                hoist_stmts(n->left, w, pre);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void optimize_stmt(ASTNode *n);
+
+// Optimizes one loop (its inner loops are done first) and, if anything was
+// moved out, turns the node into `{ prelude; while ... }` in place
+static void optimize_while(ASTNode *n) {
+    optimize_stmt(n->right);
+
+    WriteSet w = {0};
+    int calls = 0;
+    collect_writes(n->left, &w, &calls);
+    collect_writes(n->right, &w, &calls);
+    Prelude pre = { NULL, &pre.head };
+    if (!calls) {
+        strength_reduce(n, &w, &pre);
+        n->left = hoist_expr(n->left, &w, &pre);
+        hoist_stmts(n->right, &w, &pre);
+    }
+    free(w.names);
+    free(w.writes);
+    if (!pre.head) return;
+
+    ASTNode *loop = create_while(n->left, n->right);
+    loop->line = n->line;
+    *pre.tail = loop;
+    n->type = NODE_BLOCK;
+    n->left = pre.head;
+    n->right = NULL;
+}
+
+static void optimize_stmt(ASTNode *n) {
+    for (; n; n = n->next) {
+        switch (n->type) {
+            case NODE_WHILE:
+                optimize_while(n);
+                break;
+            case NODE_IF:
+                optimize_stmt(n->right);
+                optimize_stmt(n->else_branch);
+                break;
+            case NODE_BLOCK:
+            case NODE_FUNC:
+                optimize_stmt(n->left);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+ASTNode *optimize_loops(ASTNode *program) {
+    optimize_stmt(program);
+    return program;
+}
@@ -21,7 +21,7 @@ ASTNode *root = NULL; // The final result of our parsing
 /* This defines the types our tokens and rules can return */
 %union {
     int int_val;      // For integers (10)
-    char *str_val;    // For identifiers ("x")
+    const char *str_val; // For identifiers ("x"), interned by the lexer
     struct ASTNode *node; // For everything else (the tree nodes)
 }
 
@@ -31,12 +31,13 @@ ASTNode *root = NULL; // The final result of our parsing
 %token TOK_VAR TOK_IF TOK_ELSE TOK_WHILE
 %token TOK_EQ TOK_NEQ TOK_LE TOK_GE
 %token TOK_FUNC TOK_RETURN
-%token TOK_PRINT
+%token TOK_PRINT TOK_INPUT TOK_ALLOC
 
 /* Which types do our grammar rules return? -> ASTNodes */
 %type <node> program statement_list statement block
 %type <node> variable_decl assignment if_statement while_statement
-%type <node> func_definition return_statement print_statement
+%type <node> func_definition return_statement print_statement call_statement
+%type <node> param_list params arg_list args
 %type <node> expression equality comparison term factor unary primary
 
 /* Operator Precedence (Lowest to Highest) */
@@ -74,6 +75,7 @@ statement:
     | func_definition
     | return_statement
     | print_statement
+    | call_statement
     | error ';' { 
         yyerrok; // Tells Bison the error is handled
         printf("Recovering from syntax error at line %d...\n", yylineno);
@@ -96,11 +98,14 @@ variable_decl:
     }
     ;
 
-/* 6. Assignment: x = 10;*/
+/* 6. Assignment: x = 10; OR a[i] = 10;*/
 assignment:
     TOK_ID '=' expression ';' { 
         $$ = create_assign($1, $3); 
     }
+    | primary '[' expression ']' '=' expression ';' {
+        $$ = create_index_assign(create_index($1, $3), $6);
+    }
     ;
 
 /* 7. If Statement*/
@@ -121,8 +126,22 @@ while_statement:
     ;
 
 func_definition:
-    TOK_FUNC TOK_ID '(' ')' block { 
-        $$ = create_func($2, $5); 
+    TOK_FUNC TOK_ID '(' param_list ')' block { 
+        $$ = create_func($2, $4, $6); 
+    }
+    ;
+
+/* Parameter names, kept in order as a NODE_VAR list */
+param_list:
+    /* empty */ { $$ = NULL; }
+    | params
+    ;
+
+params:
+    TOK_ID { $$ = create_var($1); }
+    | TOK_ID ',' params {
+        $$ = create_var($1);
+        $$->next = $3;
     }
     ;
 
@@ -138,6 +157,13 @@ print_statement:
     }
     ;
 
+/* f(x); -- the result is discarded */
+call_statement:
+    TOK_ID '(' arg_list ')' ';' {
+        $$ = create_expr_stmt(create_call($1, $3));
+    }
+    ;
+
 /*EXPRESSION LOGIC (Stratified for Precedence)*/
 
 expression:
@@ -146,28 +172,28 @@ expression:
 
 equality:
     comparison
-    | comparison TOK_EQ comparison { $$ = create_bin_op("==", $1, $3); }
-    | comparison TOK_NEQ comparison { $$ = create_bin_op("!=", $1, $3); }
+    | comparison TOK_EQ comparison { $$ = create_bin_op(OP_EQ, $1, $3); }
+    | comparison TOK_NEQ comparison { $$ = create_bin_op(OP_NE, $1, $3); }
     ;
 
 comparison:
     term
-    | term '<' term { $$ = create_bin_op("<", $1, $3); }
-    | term '>' term { $$ = create_bin_op(">", $1, $3); }
-    | term TOK_LE term { $$ = create_bin_op("<=", $1, $3); }
-    | term TOK_GE term { $$ = create_bin_op(">=", $1, $3); }
+    | term '<' term { $$ = create_bin_op(OP_LT, $1, $3); }
+    | term '>' term { $$ = create_bin_op(OP_GT, $1, $3); }
+    | term TOK_LE term { $$ = create_bin_op(OP_LE, $1, $3); }
+    | term TOK_GE term { $$ = create_bin_op(OP_GE, $1, $3); }
     ;
 
 term:
     factor
-    | term '+' factor { $$ = create_bin_op("+", $1, $3); }
-    | term '-' factor { $$ = create_bin_op("-", $1, $3); }
+    | term '+' factor { $$ = create_bin_op(OP_ADD, $1, $3); }
+    | term '-' factor { $$ = create_bin_op(OP_SUB, $1, $3); }
     ;
 
 factor:
     unary
-    | factor '*' unary { $$ = create_bin_op("*", $1, $3); }
-    | factor '/' unary { $$ = create_bin_op("/", $1, $3); }
+    | factor '*' unary { $$ = create_bin_op(OP_MUL, $1, $3); }
+    | factor '/' unary { $$ = create_bin_op(OP_DIV, $1, $3); }
     ;
 
 unary:
@@ -175,17 +201,34 @@ unary:
     | '-' unary { 
         // Treat "-5" as "0 - 5" or create a specific unary node. 
         // For simplicity, we stick to primary or implement a 0-X binop here.
-        $$ = create_bin_op("-", create_num(0), $2); 
+        $$ = create_bin_op(OP_SUB, create_num(0), $2); 
     }
     ;
 
 primary:
     TOK_NUM { $$ = create_num($1); }
     | TOK_ID { $$ = create_var($1); }
-    | TOK_ID '(' ')' { $$ = create_call($1, NULL); } /* Simple function call */
+    | TOK_ID '(' arg_list ')' { $$ = create_call($1, $3); } /* Function call */
+    | TOK_INPUT '(' ')' { $$ = create_input(); } /* Reads one integer */
+    | TOK_ALLOC '(' expression ')' { $$ = create_alloc($3); } /* New heap array */
+    | primary '[' expression ']' { $$ = create_index($1, $3); } /* Array element */
     | '(' expression ')' { $$ = $2; }
     ;
 
+/* Call arguments, evaluated left to right */
+arg_list:
+    /* empty */ { $$ = NULL; }
+    | args
+    ;
+
+args:
+    expression
+    | expression ',' args {
+        $1->next = $3;
+        $$ = $1;
+    }
+    ;
+
 %%
 
 void yyerror(const char *s) {
@@ -12,6 +12,9 @@
 #include <termios.h> // REQUIRED for raw mode (Arrow keys)
 #include <ctype.h>   // REQUIRED for isdigit
 #include <errno.h> // REQUIRED for error checking (ECHILD, EINTR)
+#include <stdint.h>
+#include <sys/stat.h> // Required for stat (build cache)
+#include <glob.h> // Required for glob (batch submit)
 
 #include <mach/mach.h>
 #include <mach/thread_act.h>
@@ -38,7 +41,9 @@ struct Program {
     int compiled;
 };
 
-struct Program program_table[MAX_JOBS]; // Reuse MAX_JOBS limit for simplicity
+#define MAX_PROGRAMS 256 // Batch submit registers whole suites at once
+
+struct Program program_table[MAX_PROGRAMS];
 int program_count = 0;
 
 int find_program_by_id(int id) {
@@ -48,6 +53,77 @@ int find_program_by_id(int id) {
     return -1;
 }
 
+void register_program(const char *src, const char *bin_file) {
+    if (program_count < MAX_PROGRAMS) {
+        int idx = program_count++;
+        program_table[idx].id = program_count; 
+        strcpy(program_table[idx].src_file, src);
+        strcpy(program_table[idx].bin_file, bin_file);
+        program_table[idx].compiled = 1;
+        printf("Program %d registered: %s (Binary: %s)\n", program_table[idx].id, src, bin_file);
+    } else {
+        printf("Program table full!\n");
+    }
+}
+
+// BUILD CACHE
+// Each .bin gets a sidecar "<bin>.key" holding the key it was built with:
+// an FNV-1a hash of the source contents plus the compiler binary's mtime and
+// size. If the key still matches (and the .bin exists) submit skips the compile.
+// Deleting the .key file (or the .bin) forces a rebuild.
+
+#define CACHE_KEY_LEN 64
+
+static int hash_file(const char *path, uint64_t *hash) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    uint64_t h = 14695981039346656037ULL; // FNV-1a offset basis
+    unsigned char buf[8192];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            h ^= buf[i];
+            h *= 1099511628211ULL; // FNV-1a prime
+        }
+    }
+    int failed = ferror(f);
+    fclose(f);
+    if (failed) return -1;
+    *hash = h;
+    return 0;
+}
+
+// Writes the cache key for building `src` with `tool` into `key`. Returns -1 if either can't be read.
+int build_cache_key(const char *src, const char *tool, char *key) {
+    uint64_t h;
+    struct stat st;
+    if (hash_file(src, &h) != 0 || stat(tool, &st) != 0) return -1;
+    snprintf(key, CACHE_KEY_LEN, "%016llx-%llx-%llx", (unsigned long long)h,
+             (unsigned long long)st.st_mtime, (unsigned long long)st.st_size);
+    return 0;
+}
+
+// 1 if `bin_file` exists and was built with `key`
+int build_cache_hit(const char *bin_file, const char *key) {
+    char path[MAX_CMD_LEN + 8], stored[CACHE_KEY_LEN];
+    if (access(bin_file, R_OK) != 0) return 0;
+    snprintf(path, sizeof(path), "%s.key", bin_file);
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    int hit = fgets(stored, sizeof(stored), f) != NULL && strcmp(stored, key) == 0;
+    fclose(f);
+    return hit;
+}
+
+void build_cache_store(const char *bin_file, const char *key) {
+    char path[MAX_CMD_LEN + 8];
+    snprintf(path, sizeof(path), "%s.key", bin_file);
+    FILE *f = fopen(path, "w");
+    if (!f) return; // Not fatal: the next submit just rebuilds
+    fputs(key, f);
+    fclose(f);
+}
+
 // HISTORY GLOBALS
 char history[HISTORY_SIZE][MAX_CMD_LEN];
 int history_count = 0;
@@ -100,6 +176,105 @@ void delete_job(pid_t pid) {
     if (found) job_count--;
 }
 
+// VM WORKER POOL
+// `run` used to fork + exec ./bin/vm for every launch. The shell now keeps a
+// few `bin/vm --worker FD` processes that have already been exec'd and are
+// blocked reading their control pipe. Launching a program writes the request
+// (cwd, .bin path, flags) and closes the pipe; the worker's PID becomes the
+// program's PID, so `jobs`, `kill` and `&` see an ordinary child process.
+// The used slot is refilled right away, off the launch path.
+
+#define POOL_SIZE 2
+
+struct Worker {
+    pid_t pid;  // 0 = empty slot, -1 = died before being used
+    int ctl_fd; // Write end of the control pipe
+};
+
+struct Worker worker_pool[POOL_SIZE];
+char worker_vm_path[MAX_CMD_LEN];
+
+void start_worker(struct Worker *w) {
+    int fd[2];
+    if (pipe(fd) == -1) { perror("pipe"); return; }
+    fcntl(fd[1], F_SETFD, FD_CLOEXEC); // Later children (VMs, other workers) must not hold it open
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fd[1]);
+        signal(SIGINT, SIG_DFL);
+        char fd_arg[16];
+        snprintf(fd_arg, sizeof(fd_arg), "%d", fd[0]);
+        execl(worker_vm_path, "vm", "--worker", fd_arg, NULL);
+        exit(127); // No bin/vm yet: the slot dies and run falls back to fork + exec
+    }
+    close(fd[0]);
+    if (pid < 0) {
+        perror("fork");
+        close(fd[1]);
+        return;
+    }
+    w->pid = pid;
+    w->ctl_fd = fd[1];
+}
+
+void start_worker_pool() {
+    if (getcwd(worker_vm_path, sizeof(worker_vm_path) - 8) == NULL) return;
+    strcat(worker_vm_path, "/bin/vm");
+    for (int i = 0; i < POOL_SIZE; i++) start_worker(&worker_pool[i]);
+}
+
+// Called from handle_sigchld: an idle worker exited (bad bin/vm, or someone killed it)
+void worker_died(pid_t pid) {
+    for (int i = 0; i < POOL_SIZE; i++) {
+        if (worker_pool[i].pid == pid) worker_pool[i].pid = -1;
+    }
+}
+
+// Request limits of `vm --worker` (WORKER_MSG_MAX / WORKER_MAX_ARGS in vm_main.c)
+#define WORKER_MSG_MAX 4096
+#define WORKER_MAX_ARGS 512
+
+// Hands `argv` (NULL-terminated) to an idle worker. Returns its PID, or -1 if
+// no worker could take it (or the request exceeds the worker's limits) and the
+// caller should fork + exec instead.
+pid_t dispatch_to_worker(char **argv) {
+    char msg[WORKER_MSG_MAX];
+    size_t len = 0;
+    if (getcwd(msg, sizeof(msg)) == NULL) return -1;
+    len = strlen(msg) + 1;
+    for (int i = 0; argv[i] != NULL; i++) {
+        if (i >= WORKER_MAX_ARGS) return -1;
+        size_t n = strlen(argv[i]) + 1;
+        if (len + n >= sizeof(msg)) return -1; // The worker rejects a full buffer
+        memcpy(msg + len, argv[i], n);
+        len += n;
+    }
+
+    for (int i = 0; i < POOL_SIZE; i++) {
+        struct Worker *w = &worker_pool[i];
+        if (w->pid == 0) continue;
+        pid_t pid = w->pid;
+        int fd = w->ctl_fd;
+        w->pid = 0;
+        if (pid < 0) { // Died while idle: recycle the slot
+            close(fd);
+            start_worker(w);
+            continue;
+        }
+
+        // A worker that died since the last SIGCHLD turns the write into EPIPE, not a fatal SIGPIPE
+        void (*old_pipe)(int) = signal(SIGPIPE, SIG_IGN);
+        ssize_t written = write(fd, msg, len);
+        signal(SIGPIPE, old_pipe);
+        close(fd); // EOF tells the worker the request is complete
+
+        start_worker(w); // Refill now so the next run finds a warm worker
+        if (written == (ssize_t)len) return pid;
+    }
+    return -1;
+}
+
 // HISTORY FUNCTIONS
 void add_to_history(const char *cmd) {
     if (strlen(cmd) == 0) return; // Don't save empty commands
@@ -257,6 +432,7 @@ void handle_sigchld(int sig) {
     while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
         if (WIFEXITED(status) || WIFSIGNALED(status)) {
             delete_job(pid); // Remove from list if finished
+            worker_died(pid);
         }
         // if WIF exited and WIFsignaled are false it means it was likely just Stopped (Ctrl+Z) i.e wifstopped will be true.
     }
@@ -801,6 +977,133 @@ void start_debugger(char **args) {
     signal(SIGCHLD, handle_sigchld);
 }
 
+// BATCH SUBMIT
+// `submit -j N a.lang b.lang dir/*.lang` expands globs, registers cache hits
+// straight away and keeps up to N compilers running at once. Each program is
+// registered as soon as its compiler exits, so IDs follow completion order.
+
+struct Build {
+    char src[MAX_CMD_LEN];
+    char bin_file[MAX_CMD_LEN];
+    char key[CACHE_KEY_LEN];
+    int have_key;
+    pid_t pid; // 0 = queued, >0 = compiling, -1 = done
+};
+
+static pid_t start_build(const char *compiler_path, struct Build *b, sigset_t *oldmask) {
+    printf("[Shell] Compiling %s -> %s...\n", b->src, b->bin_file);
+    fflush(stdout); // Don't let the child inherit buffered output
+    pid_t pid = fork();
+    if (pid == 0) {
+        sigprocmask(SIG_SETMASK, oldmask, NULL); // Unblock in child
+        // Use execv with absolute path
+        char *args[] = { "compiler", "--emit=bin", "-o", b->bin_file, b->src, NULL };
+        execv(compiler_path, args);
+        perror("execv compiler"); // Should only print if execv fails
+        exit(127);
+    }
+    if (pid < 0) perror("fork");
+    return pid;
+}
+
+void submit_programs(char **files, int jobs) {
+    // Construct absolute path to compiler
+    char compiler_path[1024];
+    if (getcwd(compiler_path, sizeof(compiler_path)) != NULL) {
+        strcat(compiler_path, "/bin/compiler");
+    } else {
+        perror("getcwd");
+        return;
+    }
+
+    // EXPAND: every argument may be a glob; a pattern with no match is kept as-is
+    // so the compiler reports the missing file
+    glob_t g;
+    int flags = GLOB_NOCHECK;
+    for (int i = 0; files[i] != NULL; i++) {
+        glob(files[i], flags, NULL, &g);
+        flags |= GLOB_APPEND;
+    }
+
+    struct Build *builds = calloc(g.gl_pathc, sizeof(struct Build));
+    if (!builds) { perror("calloc"); globfree(&g); return; }
+
+    int queued = 0, cached = 0;
+    for (size_t i = 0; i < g.gl_pathc; i++) {
+        struct Build *b = &builds[queued];
+        snprintf(b->src, sizeof(b->src), "%s", g.gl_pathv[i]);
+        char base[MAX_CMD_LEN];
+        strcpy(base, b->src);
+        char *dot = strrchr(base, '.');
+        if (dot) *dot = '\0';
+        snprintf(b->bin_file, sizeof(b->bin_file), "%s.bin", base);
+
+        // CACHE: unchanged source + unchanged compiler -> reuse the existing .bin
+        b->have_key = build_cache_key(b->src, compiler_path, b->key) == 0;
+        if (b->have_key && build_cache_hit(b->bin_file, b->key)) {
+            printf("[Shell] Cache hit: %s is up to date\n", b->bin_file);
+            register_program(b->src, b->bin_file);
+            cached++;
+            continue;
+        }
+        queued++;
+    }
+    globfree(&g);
+
+    // BLOCK SIGCHLD to prevent handle_sigchld from reaping the compilers
+    sigset_t mask, oldmask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &oldmask);
+
+    int next = 0, running = 0, failed = 0;
+    while (next < queued || running > 0) {
+        // Top up the pool
+        while (running < jobs && next < queued) {
+            struct Build *b = &builds[next++];
+            b->pid = start_build(compiler_path, b, &oldmask);
+            if (b->pid > 0) running++;
+            else { b->pid = -1; failed++; }
+        }
+        if (running == 0) break;
+
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            perror("waitpid");
+            break;
+        }
+
+        struct Build *b = NULL;
+        for (int i = 0; i < next; i++) {
+            if (builds[i].pid == pid) { b = &builds[i]; break; }
+        }
+        if (!b) {
+            // A background job finished meanwhile; do what handle_sigchld would
+            if (WIFEXITED(status) || WIFSIGNALED(status)) { delete_job(pid); worker_died(pid); }
+            continue;
+        }
+        b->pid = -1;
+        running--;
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            printf("[Shell] Compilation of %s Failed. Status: 0x%x, Exit: %d\n", b->src, status, WEXITSTATUS(status));
+            failed++;
+            continue;
+        }
+        if (b->have_key) build_cache_store(b->bin_file, b->key);
+        register_program(b->src, b->bin_file);
+    }
+    sigprocmask(SIG_SETMASK, &oldmask, NULL); // Unblock in parent
+
+    if (queued + cached > 1) {
+        printf("[Shell] Submitted %d programs: %d compiled, %d cached, %d failed\n",
+               queued + cached, queued - failed, cached, failed);
+    }
+    free(builds);
+}
+
 void execute_command(char **args) {
     if (args[0] == NULL) {
         return; // Empty command
@@ -834,123 +1137,70 @@ void execute_command(char **args) {
 
     // PROGRAM COMMANDS (submit, run, debug)
     if (strcmp(args[0], "submit") == 0) {
-        // ... (submit implementation is sequential, ignore background)
-        if (args[1] == NULL) {
-            printf("Usage: submit <source_file>\n");
-            return;
+        // ... (submit waits for its own builds, ignore background)
+        int jobs = 1;
+        int first = 1;
+        if (args[1] != NULL && strcmp(args[1], "-j") == 0) {
+            jobs = args[2] ? atoi(args[2]) : 0;
+            first = 3;
+        } else if (args[1] != NULL && strncmp(args[1], "-j", 2) == 0) {
+            jobs = atoi(args[1] + 2); // -jN
+            first = 2;
         }
-
-        char *src = args[1];
-        char base[MAX_CMD_LEN];
-        strcpy(base, src);
-        char *dot = strrchr(base, '.');
-        if (dot) *dot = '\0'; 
-
-        char asm_file[MAX_CMD_LEN];
-        char bin_file[MAX_CMD_LEN];
-        sprintf(asm_file, "%s.asm", base);
-        sprintf(bin_file, "%s.bin", base);
-
-        // 1. COMPILE
-        printf("[Shell] Compiling %s -> %s...\n", src, asm_file);
-        
-        // Construct absolute path to compiler
-        char compiler_path[1024];
-        if (getcwd(compiler_path, sizeof(compiler_path)) != NULL) {
-            strcat(compiler_path, "/bin/compiler");
-        } else {
-            perror("getcwd");
+        if (args[first] == NULL || jobs < 1) {
+            printf("Usage: submit [-j N] <source_file>...\n");
             return;
         }
-
-        // BLOCK SIGCHLD to prevent handle_sigchld from reaping the process
-        sigset_t mask, oldmask;
-        sigemptyset(&mask);
-        sigaddset(&mask, SIGCHLD);
-        sigprocmask(SIG_BLOCK, &mask, &oldmask);
-
-        pid_t pid1 = fork();
-        if (pid1 == 0) {
-            sigprocmask(SIG_SETMASK, &oldmask, NULL); // Unblock in child
-            int fd = open(asm_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-            if (fd < 0) { perror("open asm"); exit(1); }
-            dup2(fd, STDOUT_FILENO);
-            close(fd);
-            // Use execv with absolute path
-            char *args[] = { "compiler", src, NULL };
-            execv(compiler_path, args);
-            perror("execv compiler"); // Should only print if execv fails
-            exit(127);
-        }
-        int status;
-        waitpid(pid1, &status, 0);
-        sigprocmask(SIG_SETMASK, &oldmask, NULL); // Unblock in parent
-
-        if (WEXITSTATUS(status) != 0) {
-            printf("[Shell] Compilation Failed. Status: 0x%x, Exit: %d\n", status, WEXITSTATUS(status));
-            return;
-        }
-
-        // 2. ASSEMBLE
-        printf("[Shell] Assembling %s -> %s...\n", asm_file, bin_file);
-        
-        sigprocmask(SIG_BLOCK, &mask, &oldmask); // Block again
-        pid_t pid2 = fork();
-        if (pid2 == 0) {
-            sigprocmask(SIG_SETMASK, &oldmask, NULL);
-            execlp("python3", "python3", "src/vm/assembler.py", asm_file, bin_file, NULL);
-            perror("exec assembler");
-            exit(1);
-        }
-        waitpid(pid2, &status, 0);
-        sigprocmask(SIG_SETMASK, &oldmask, NULL); // Unblock
-
-        if (WEXITSTATUS(status) != 0) {
-            printf("[Shell] Assembly Failed.\n");
-            return;
-        }
-
-        // 3. REGISTER
-        if (program_count < MAX_JOBS) {
-            int idx = program_count++;
-            program_table[idx].id = program_count; 
-            strcpy(program_table[idx].src_file, src);
-            strcpy(program_table[idx].bin_file, bin_file);
-            program_table[idx].compiled = 1;
-            printf("Program %d registered: %s (Binary: %s)\n", program_table[idx].id, src, bin_file);
-        } else {
-            printf("Program table full!\n");
-        }
+        submit_programs(&args[first], jobs);
         return;
     }
 
     if (strcmp(args[0], "run") == 0) {
         if (args[1] == NULL) {
-             printf("Usage: run <program_id>\n");
+             printf("Usage: run <program_id>...\n");
              return;
         }
-        int pid_idx = atoi(args[1]);
-        int idx = find_program_by_id(pid_idx);
-        
-        if (idx == -1) {
-            printf("Program ID %d not found.\n", pid_idx);
-            return;
+        // Several IDs run together in one VM process as green threads
+        // (`vm --sched`), so they share one job and one stdin
+        char *bins[MAX_PROGRAMS];
+        char job_name[128] = "run";
+        int count = 0;
+        for (int i = 1; args[i] != NULL && count < MAX_PROGRAMS; i++) {
+            int pid_idx = atoi(args[i]);
+            int idx = find_program_by_id(pid_idx);
+            if (idx == -1) {
+                printf("Program ID %d not found.\n", pid_idx);
+                return;
+            }
+            bins[count++] = program_table[idx].bin_file;
+            size_t jl = strlen(job_name);
+            snprintf(job_name + jl, sizeof(job_name) - jl, " %d", pid_idx);
         }
-        
-        printf("[Shell] Running Program %d (%s)...\n", pid_idx, program_table[idx].bin_file);
-        pid_t pid = fork();
-        if (pid == 0) {
-            execlp("./bin/vm", "./bin/vm", program_table[idx].bin_file, NULL);
-            perror("exec vm");
-            exit(1);
+
+        char *vm_args[MAX_PROGRAMS + 3];
+        int argn = 0;
+        vm_args[argn++] = "./bin/vm";
+        if (count > 1) vm_args[argn++] = "--sched";
+        for (int i = 0; i < count; i++) vm_args[argn++] = bins[i];
+        vm_args[argn] = NULL;
+
+        if (count == 1) printf("[Shell] Running Program %d (%s)...\n", atoi(args[1]), bins[0]);
+        else printf("[Shell] Running %d programs as green threads (%s)...\n", count, job_name);
+        fflush(stdout); // The worker shares our stdout
+        pid_t pid = dispatch_to_worker(&vm_args[1]);
+        if (pid < 0) {
+            pid = fork();
+            if (pid == 0) {
+                execvp(vm_args[0], vm_args);
+                perror("exec vm");
+                exit(1);
+            }
         }
         
         if (!background) {
             waitpid(pid, NULL, 0);
         } else {
-            printf("[Shell] Program %d running in background (PID %d)\n", program_table[idx].id, pid);
-            char job_name[128];
-            snprintf(job_name, sizeof(job_name), "run %d", program_table[idx].id);
+            printf("[Shell] %s running in background (PID %d)\n", job_name, pid);
             add_job(pid, 1, job_name);
         }
         return;
@@ -1165,6 +1415,8 @@ int main() {
     signal(SIGTTOU, SIG_IGN);
     signal(SIGCHLD, handle_sigchld); // Zombie cleanup
 
+    start_worker_pool(); // Pre-exec'd VMs for low-latency `run`
+
     while (1) {
         printf("myshell> ");
         fflush(stdout);
@@ -1201,9 +1453,9 @@ int main() {
         
         int last_arg_idx = 0;
         while (args[last_arg_idx] != NULL) last_arg_idx++;
-        if (last_arg_idx > 0 && strcmp(args[last_arg_idx-1], "&") == 0) {
+        if (is_pipeline && last_arg_idx > 0 && strcmp(args[last_arg_idx-1], "&") == 0) {
             background = 1;
-            args[last_arg_idx-1] = NULL; // Remove the &
+            args[last_arg_idx-1] = NULL; // Remove the & (execute_command strips its own)
         }
 
         if (is_pipeline) {
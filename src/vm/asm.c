@@ -0,0 +1,328 @@
+// Native Assembler
+// Drop-in replacement for src/vm/assembler.py: same syntax (labels, .line,
+// .stack/.heap, .global/.func, numeric or label arguments) and byte-identical
+// .bin output. The source is mmap'd and scanned once; arguments are written
+// as placeholders and resolved from a backpatch list once every label is known.
+//
+// Usage: asm <input.asm> <output.bin>
+
+#include "bytecode.h"
+#include "opcodes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DEFAULT_STACK_SIZE 256
+#define DEFAULT_HEAP_SIZE 65536
+#define MAX_TOKENS 3 // Nothing looks past the third word of a line
+
+// A word of the source. Points into the mapping; never NUL-terminated.
+typedef struct {
+    const char *s;
+    int len;
+} Token;
+
+static const struct { const char *name; uint8_t op; } opcode_table[] = {
+    {"PUSH", PUSH}, {"POP", POP}, {"DUP", DUP}, {"HALT", HALT},
+    {"ADD", ADD}, {"SUB", SUB}, {"MUL", MUL}, {"DIV", DIV}, {"CMP", CMP},
+    {"LT", LT}, {"EQ", EQ}, {"NE", NE}, {"LE", LE}, {"GT", GT}, {"GE", GE},
+    {"JMP", JMP}, {"JZ", JZ}, {"JNZ", JNZ},
+    {"JEQ", JEQ}, {"JNE", JNE}, {"JLT", JLT}, {"JLE", JLE}, {"JGT", JGT}, {"JGE", JGE},
+    {"STORE", STORE}, {"LOAD", LOAD}, {"LOADI", LOADI}, {"STOREI", STOREI}, {"CALL", CALL}, {"RET", RET},
+    {"LOAD_LOCAL", LOAD_LOCAL}, {"STORE_LOCAL", STORE_LOCAL}, {"ENTER", ENTER}, {"LEAVE", LEAVE},
+    {"TAILCALL", TAILCALL},
+    {"PRINT", PRINT}, {"INPUT", INPUT}, {"ALLOC", ALLOC},
+    {"MEMCPY", MEMCPY}, {"MEMSET", MEMSET}, {"MEMCMP", MEMCMP},
+};
+
+// --- Growable byte buffer ---
+typedef struct {
+    uint8_t *data;
+    size_t len, cap;
+} Buffer;
+
+static void buf_append(Buffer *b, const void *src, size_t n) {
+    if (b->len + n > b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 256;
+        while (cap < b->len + n) cap *= 2;
+        b->data = realloc(b->data, cap);
+        if (!b->data) { perror("realloc"); exit(1); }
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, src, n);
+    b->len += n;
+}
+
+// --- Label hash table (open addressing, FNV-1a over the name) ---
+typedef struct {
+    Token name;   // name.s == NULL marks an empty slot
+    int32_t addr;
+} Label;
+
+typedef struct {
+    Label *slots;
+    uint32_t cap, count;
+} LabelTable;
+
+static uint32_t hash_token(Token t) {
+    return bytecode_checksum((const uint8_t *)t.s, t.len);
+}
+
+static int token_eq(Token a, Token b) {
+    return a.len == b.len && memcmp(a.s, b.s, a.len) == 0;
+}
+
+static Label *label_slot(LabelTable *t, Token name) {
+    uint32_t i = hash_token(name) & (t->cap - 1);
+    while (t->slots[i].name.s && !token_eq(t->slots[i].name, name)) i = (i + 1) & (t->cap - 1);
+    return &t->slots[i];
+}
+
+static void label_define(LabelTable *t, Token name, int32_t addr) {
+    if ((t->count + 1) * 2 > t->cap) {
+        LabelTable grown = { calloc(t->cap * 2, sizeof(Label)), t->cap * 2, t->count };
+        if (!grown.slots) { perror("calloc"); exit(1); }
+        for (uint32_t i = 0; i < t->cap; i++) {
+            if (t->slots[i].name.s) *label_slot(&grown, t->slots[i].name) = t->slots[i];
+        }
+        free(t->slots);
+        *t = grown;
+    }
+    Label *l = label_slot(t, name);
+    if (!l->name.s) t->count++;
+    l->name = name;
+    l->addr = addr; // A redefinition wins everywhere, as in the two-pass Python version
+}
+
+static Label *label_find(LabelTable *t, Token name) {
+    Label *l = label_slot(t, name);
+    return l->name.s ? l : NULL;
+}
+
+// --- Pending work resolved after the scan ---
+typedef struct {
+    uint32_t offset;  // Where the 4-byte argument goes in the code buffer
+    Token arg;
+} Patch;
+
+typedef struct {
+    uint32_t kind;
+    Token name;
+    int32_t value;    // Unused for labels, which are looked up at the end
+} PendingSymbol;
+
+#define GROW(arr, count, cap) do { \
+    if ((count) == (cap)) { \
+        (cap) = (cap) ? (cap) * 2 : 64; \
+        (arr) = realloc((arr), (cap) * sizeof(*(arr))); \
+        if (!(arr)) { perror("realloc"); exit(1); } \
+    } \
+} while (0)
+
+// Whole-token integer parse, accepting what Python's int() accepts for our inputs
+static int parse_int(Token t, int32_t *out) {
+    char tmp[32];
+    if (t.len == 0 || t.len >= (int)sizeof(tmp)) return 0;
+    memcpy(tmp, t.s, t.len);
+    tmp[t.len] = '\0';
+    char *end;
+    errno = 0;
+    long v = strtol(tmp, &end, 10);
+    if (*end != '\0' || errno != 0) return 0;
+    *out = (int32_t)v;
+    return 1;
+}
+
+static int lookup_opcode(Token t, uint8_t *op) {
+    char upper[16];
+    if (t.len >= (int)sizeof(upper)) return 0;
+    for (int i = 0; i < t.len; i++) upper[i] = toupper((unsigned char)t.s[i]);
+    upper[t.len] = '\0';
+    for (size_t i = 0; i < sizeof(opcode_table) / sizeof(opcode_table[0]); i++) {
+        if (strcmp(upper, opcode_table[i].name) == 0) {
+            *op = opcode_table[i].op;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int token_is(Token t, const char *word) {
+    return t.len == (int)strlen(word) && memcmp(t.s, word, t.len) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("Usage: asm <input.asm> <output.bin>\n");
+        return 0;
+    }
+    const char *input_file = argv[1];
+    const char *output_file = argv[2];
+
+    int fd = open(input_file, O_RDONLY);
+    if (fd < 0) {
+        perror(input_file);
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(input_file);
+        close(fd);
+        return 1;
+    }
+    const char *src = "";
+    size_t src_len = st.st_size;
+    if (src_len > 0) {
+        void *map = mmap(NULL, src_len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            perror("mmap");
+            close(fd);
+            return 1;
+        }
+        src = map;
+    }
+    close(fd);
+
+    Buffer code = {0}, lines = {0};
+    LabelTable labels = { calloc(64, sizeof(Label)), 64, 0 };
+    Patch *patches = NULL;
+    int patch_count = 0, patch_cap = 0;
+    PendingSymbol *symbols = NULL;
+    int symbol_count = 0, symbol_cap = 0;
+    Token *functions = NULL; // Labels marked with .func
+    int function_count = 0, function_cap = 0;
+    int32_t current_line = 0;
+    int32_t stack_size = DEFAULT_STACK_SIZE, heap_size = DEFAULT_HEAP_SIZE;
+    if (!labels.slots) { perror("calloc"); return 1; }
+
+    // --- Single pass: tokenize, emit, and queue anything that needs a label ---
+    const char *p = src, *end = src + src_len;
+    while (p < end) {
+        // One physical line; '\r' ends a line too, like Python's universal newlines
+        const char *eol = p;
+        while (eol < end && *eol != '\n' && *eol != '\r') eol++;
+        const char *comment = memchr(p, ';', eol - p);
+        const char *stop = comment ? comment : eol;
+
+        Token parts[MAX_TOKENS];
+        int n = 0;
+        for (const char *q = p; q < stop; ) {
+            while (q < stop && isspace((unsigned char)*q)) q++;
+            if (q == stop) break;
+            const char *w = q;
+            while (q < stop && !isspace((unsigned char)*q)) q++;
+            if (n < MAX_TOKENS) parts[n] = (Token){ w, (int)(q - w) };
+            n++;
+        }
+        p = eol + 1;
+        if (n == 0) continue;
+
+        // Label definition: "name:" (the rest of the line is ignored)
+        if (parts[0].s[parts[0].len - 1] == ':') {
+            Token name = { parts[0].s, parts[0].len - 1 };
+            label_define(&labels, name, (int32_t)code.len);
+            GROW(symbols, symbol_count, symbol_cap);
+            symbols[symbol_count++] = (PendingSymbol){ SYM_LABEL, name, 0 };
+            continue;
+        }
+
+        // Directives. Malformed numbers are treated like Python would crash on them.
+        int32_t num;
+        if (token_is(parts[0], ".line") || token_is(parts[0], ".stack") || token_is(parts[0], ".heap")) {
+            if (n > 1) {
+                if (!parse_int(parts[1], &num)) {
+                    fprintf(stderr, "Error: Invalid number '%.*s'\n", parts[1].len, parts[1].s);
+                    return 1;
+                }
+                if (token_is(parts[0], ".line")) current_line = num;
+                else if (token_is(parts[0], ".stack")) stack_size = num;
+                else heap_size = num;
+            }
+            continue;
+        }
+        if (token_is(parts[0], ".global")) {
+            if (n > 2) {
+                if (!parse_int(parts[2], &num)) {
+                    fprintf(stderr, "Error: Invalid number '%.*s'\n", parts[2].len, parts[2].s);
+                    return 1;
+                }
+                GROW(symbols, symbol_count, symbol_cap);
+                symbols[symbol_count++] = (PendingSymbol){ SYM_GLOBAL, parts[1], num };
+            }
+            continue;
+        }
+        if (token_is(parts[0], ".func")) {
+            if (n > 1) {
+                GROW(functions, function_count, function_cap);
+                functions[function_count++] = parts[1];
+            }
+            continue;
+        }
+
+        uint8_t op;
+        if (!lookup_opcode(parts[0], &op)) continue; // Unknown words are skipped, as before
+
+        if (current_line > 0) {
+            LineEntry e = { (int32_t)code.len, current_line };
+            buf_append(&lines, &e, sizeof(e));
+        }
+        buf_append(&code, &op, 1);
+        if (n > 1) {
+            // Placeholder; a label of the same name beats a numeric reading, so every argument is patched
+            GROW(patches, patch_count, patch_cap);
+            patches[patch_count++] = (Patch){ (uint32_t)code.len, parts[1] };
+            int32_t zero = 0;
+            buf_append(&code, &zero, sizeof(zero));
+        }
+    }
+
+    // --- Backpatch arguments now that all labels are known ---
+    for (int i = 0; i < patch_count; i++) {
+        Label *l = label_find(&labels, patches[i].arg);
+        int32_t val = 0;
+        if (l) val = l->addr;
+        else if (!parse_int(patches[i].arg, &val)) {
+            printf("Error: Invalid argument '%.*s'\n", patches[i].arg.len, patches[i].arg.s);
+            val = 0;
+        }
+        memcpy(code.data + patches[i].offset, &val, sizeof(val));
+    }
+
+    // --- SYMBOLS section: count, entries, then names ---
+    Buffer syms = {0}, names = {0};
+    uint32_t count = symbol_count;
+    buf_append(&syms, &count, sizeof(count));
+    for (int i = 0; i < symbol_count; i++) {
+        PendingSymbol *s = &symbols[i];
+        SymbolEntry e = { s->kind, s->value, (uint32_t)names.len, (uint32_t)s->name.len };
+        if (s->kind == SYM_LABEL) {
+            e.value = label_find(&labels, s->name)->addr;
+            for (int f = 0; f < function_count; f++) {
+                if (token_eq(functions[f], s->name)) { e.kind = SYM_FUNC; break; }
+            }
+        }
+        buf_append(&syms, &e, sizeof(e));
+        buf_append(&names, s->name.s, s->name.len);
+    }
+    if (names.len) buf_append(&syms, names.data, names.len);
+
+    BytecodeSection sections[] = {
+        { SECTION_CODE, code.data, (uint32_t)code.len },
+        { SECTION_LINES, lines.data, (uint32_t)lines.len },
+        { SECTION_SYMBOLS, syms.data, (uint32_t)syms.len },
+    };
+    if (bytecode_write(output_file, stack_size, heap_size, sections, 3) != 0) {
+        fprintf(stderr, "Error: could not write %s\n", output_file);
+        return 1;
+    }
+    printf("Generated %s\n", output_file);
+
+    if (src_len > 0) munmap((void *)src, src_len);
+    return 0;
+}
@@ -7,11 +7,67 @@ import struct
 OPCODES = {
     "PUSH": 0x01, "POP": 0x02, "DUP": 0x03, "HALT": 0xFF,
     "ADD": 0x10, "SUB": 0x11, "MUL": 0x12, "DIV": 0x13, "CMP": 0x14,
+    "LT": 0x14, "EQ": 0x15, "NE": 0x16, "LE": 0x17, "GT": 0x18, "GE": 0x19,
     "JMP": 0x20, "JZ": 0x21, "JNZ": 0x22,
-    "STORE": 0x30, "LOAD": 0x31, "CALL": 0x40, "RET": 0x41,
-    "PRINT": 0x50, "INPUT": 0x51, "ALLOC": 0x60
+    "JEQ": 0x23, "JNE": 0x24, "JLT": 0x25, "JLE": 0x26, "JGT": 0x27, "JGE": 0x28,
+    "STORE": 0x30, "LOAD": 0x31, "LOADI": 0x34, "STOREI": 0x35, "CALL": 0x40, "RET": 0x41,
+    "LOAD_LOCAL": 0x32, "STORE_LOCAL": 0x33, "ENTER": 0x42, "LEAVE": 0x43,
+    "TAILCALL": 0x44,
+    "PRINT": 0x50, "INPUT": 0x51, "ALLOC": 0x60,
+    "MEMCPY": 0x61, "MEMSET": 0x62, "MEMCMP": 0x63
 }
 
+# Container format (see src/vm/bytecode.h): header, section table, then
+# 8-byte aligned section payloads
+BC_MAGIC = b"CSVM"
+BC_VERSION = 2
+BC_ALIGN = 8
+BC_HEADER = struct.Struct("<4sHHIIII")   # magic, version, section count, stack, heap, flags, table checksum
+BC_SECTION = struct.Struct("<IIII")      # type, offset, size, checksum
+LINE_ENTRY = struct.Struct("<ii")        # address, line
+SYMBOL_ENTRY = struct.Struct("<IiII")    # kind, value, name offset, name length
+SECTION_CODE, SECTION_LINES, SECTION_SYMBOLS = 1, 2, 3
+SYM_GLOBAL, SYM_FUNC, SYM_LABEL = 1, 2, 3
+DEFAULT_STACK_SIZE = 256
+DEFAULT_HEAP_SIZE = 65536
+
+def checksum(data):
+    """32-bit FNV-1a over the code bytes, matching bytecode_checksum() in the VM."""
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+def pack_symbols(symbols):
+    """SECTION_SYMBOLS payload: count, fixed-size entries, then the name bytes."""
+    entries = bytearray()
+    names = bytearray()
+    for kind, name, value in symbols:
+        raw = name.encode()
+        entries.extend(SYMBOL_ENTRY.pack(kind, value, len(names), len(raw)))
+        names.extend(raw)
+    return struct.pack("<I", len(symbols)) + bytes(entries) + bytes(names)
+
+def write_container(output_file, sections, stack_size, heap_size):
+    """Writes the header, the section table and the aligned payloads."""
+    table = bytearray()
+    offset = BC_HEADER.size + BC_SECTION.size * len(sections)
+    layout = []
+    for kind, data in sections:
+        offset = (offset + BC_ALIGN - 1) & ~(BC_ALIGN - 1)
+        table.extend(BC_SECTION.pack(kind, offset, len(data), checksum(data)))
+        layout.append((offset, data))
+        offset += len(data)
+    header = BC_HEADER.pack(BC_MAGIC, BC_VERSION, len(sections), stack_size, heap_size, 0, checksum(table))
+
+    out = bytearray(header)
+    out.extend(table)
+    for offset, data in layout:
+        out.extend(bytes(offset - len(out)))
+        out.extend(data)
+    with open(output_file, 'wb') as f:
+        f.write(out)
+
 def assemble(input_file, output_file):
     """
     Reads an assembly source file and converts it into binary bytecode.
@@ -49,15 +105,20 @@ def assemble(input_file, output_file):
     # --- Pass 2: Generate Bytecode & Debug Map ---
     # Now we scan the code a second time to actually generate the binary data.
     bytecode = bytearray()
-    debug_map = [] # List of (address, line_number)
+    debug_map = bytearray() # Packed (address, line_number) pairs
+    symbols = []            # (kind, name, value) in order of appearance
+    functions = set()       # Labels marked with .func
     current_line = 0
+    stack_size = DEFAULT_STACK_SIZE
+    heap_size = DEFAULT_HEAP_SIZE
 
     for line in lines:
         parts = line.split(';')[0].split()
         if not parts: continue
         
-        # We already handled labels in Pass 1, so we just skip them here
+        # Labels were resolved in Pass 1; here they are only recorded as symbols
         if parts[0].endswith(':'):
+            symbols.append((SYM_LABEL, parts[0][:-1], labels[parts[0][:-1]]))
             continue
             
         # Handle .line directive
@@ -65,13 +126,33 @@ def assemble(input_file, output_file):
             if len(parts) > 1:
                 current_line = int(parts[1])
             continue
+
+        # Resource directives recorded in the header: ".stack N" / ".heap N"
+        if parts[0] == '.stack':
+            if len(parts) > 1:
+                stack_size = int(parts[1])
+            continue
+        if parts[0] == '.heap':
+            if len(parts) > 1:
+                heap_size = int(parts[1])
+            continue
+
+        # Symbol directives: ".global name addr" and ".func label"
+        if parts[0] == '.global':
+            if len(parts) > 2:
+                symbols.append((SYM_GLOBAL, parts[1], int(parts[2])))
+            continue
+        if parts[0] == '.func':
+            if len(parts) > 1:
+                functions.add(parts[1])
+            continue
         
         instr = parts[0].upper()
         if instr in OPCODES:
             # Record debug info for the start of this instruction
             # Only checking "if current_line > 0" to avoid noise
             if current_line > 0:
-                debug_map.append(f"{len(bytecode)} {current_line}\n")
+                debug_map.extend(LINE_ENTRY.pack(len(bytecode), current_line))
 
             # 1. Write the Opcode
             bytecode.append(OPCODES[instr])
@@ -93,16 +174,15 @@ def assemble(input_file, output_file):
                 # Pack the value as a 32-bit little-endian integer
                 bytecode.extend(struct.pack("<i", val))
         
-    # Write the final sequence of bytes to the output file
-    with open(output_file, 'wb') as f:
-        f.write(bytecode)
-        
-    # Write debug file (same base name as output, but with .dbg extension)
-    # If output is "prog.bin", debug is "prog.dbg"
-    dbg_file = output_file.rsplit('.', 1)[0] + ".dbg"
-    with open(dbg_file, 'w') as f:
-        f.writelines(debug_map)
-    print(f"Generated {output_file} and {dbg_file}")
+    symbols = [(SYM_FUNC if kind == SYM_LABEL and name in functions else kind, name, value)
+               for kind, name, value in symbols]
+
+    # One container holds the code and its debug information
+    sections = [(SECTION_CODE, bytes(bytecode)),
+                (SECTION_LINES, bytes(debug_map)),
+                (SECTION_SYMBOLS, pack_symbols(symbols))]
+    write_container(output_file, sections, stack_size, heap_size)
+    print(f"Generated {output_file}")
 
 if __name__ == "__main__":
     # Ensure the user provides input and output filenames
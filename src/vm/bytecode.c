@@ -0,0 +1,210 @@
+#include "bytecode.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// 32-bit FNV-1a
+uint32_t bytecode_checksum(const uint8_t *data, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static const SectionEntry *find_section(const BytecodeImage *img, uint32_t type) {
+    for (int i = 0; i < img->section_count; i++) {
+        if (img->sections[i].type == type) return &img->sections[i];
+    }
+    return NULL;
+}
+
+int bytecode_load(const char *path, uint32_t max_stack, uint32_t max_heap, BytecodeImage *img) {
+    memset(img, 0, sizeof(*img));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening file %s\n", path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(BytecodeHeader)) {
+        fprintf(stderr, "Error: %s is too small to be a bytecode file\n", path);
+        close(fd);
+        return -1;
+    }
+
+    // Execute directly from a read-only mapping; no copy of the code is made
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    img->map = map;
+    img->map_size = st.st_size;
+
+    const BytecodeHeader *hdr = (const BytecodeHeader *)map;
+    size_t table_end = sizeof(BytecodeHeader) + (size_t)hdr->section_count * sizeof(SectionEntry);
+    const char *problem = NULL;
+
+    if (memcmp(hdr->magic, BC_MAGIC, 4) != 0) problem = "bad magic (re-assemble with src/vm/assembler.py)";
+    else if (hdr->version != BC_VERSION) problem = "unsupported format version (re-assemble)";
+    else if (table_end > img->map_size) problem = "truncated section table";
+    else if (bytecode_checksum((const uint8_t *)map + sizeof(BytecodeHeader),
+                               table_end - sizeof(BytecodeHeader)) != hdr->table_checksum)
+        problem = "section table checksum mismatch";
+    else if (hdr->stack_size > max_stack) problem = "program needs a larger operand stack than this VM provides";
+    else if (hdr->heap_size > max_heap) problem = "program needs a larger heap than this VM provides";
+
+    if (!problem) {
+        img->sections = (const SectionEntry *)((const uint8_t *)map + sizeof(BytecodeHeader));
+        img->section_count = hdr->section_count;
+        img->stack_size = hdr->stack_size;
+        img->heap_size = hdr->heap_size;
+        for (int i = 0; i < img->section_count && !problem; i++) {
+            const SectionEntry *s = &img->sections[i];
+            if ((size_t)s->offset + s->size > img->map_size) problem = "section extends past end of file";
+        }
+    }
+
+    // The code is always needed, so it is the only section validated eagerly
+    if (!problem) {
+        const SectionEntry *code = find_section(img, SECTION_CODE);
+        if (!code) problem = "no CODE section";
+        else if (bytecode_checksum((const uint8_t *)map + code->offset, code->size) != code->checksum)
+            problem = "CODE checksum mismatch";
+        else {
+            img->code = (const uint8_t *)map + code->offset;
+            img->code_size = code->size;
+            img->code_checksum = code->checksum;
+            img->checked_sections |= 1u << SECTION_CODE;
+        }
+    }
+
+    if (problem) {
+        fprintf(stderr, "Error: %s: %s\n", path, problem);
+        bytecode_unload(img);
+        return -1;
+    }
+    return 0;
+}
+
+void bytecode_unload(BytecodeImage *img) {
+    if (img->map) munmap(img->map, img->map_size);
+    memset(img, 0, sizeof(*img));
+}
+
+const void *bytecode_section(BytecodeImage *img, uint32_t type, uint32_t *size) {
+    const SectionEntry *s = find_section(img, type);
+    if (!s) return NULL;
+
+    const uint8_t *data = (const uint8_t *)img->map + s->offset;
+    if (!(img->checked_sections & (1u << type))) {
+        // First access: this is where the pages are actually read
+        if (bytecode_checksum(data, s->size) != s->checksum) {
+            fprintf(stderr, "Warning: section %u is corrupt, ignoring it\n", type);
+            return NULL;
+        }
+        img->checked_sections |= 1u << type;
+    }
+    if (size) *size = s->size;
+    return data;
+}
+
+int bytecode_symbol_count(BytecodeImage *img) {
+    uint32_t size;
+    const uint32_t *data = bytecode_section(img, SECTION_SYMBOLS, &size);
+    if (!data || size < sizeof(uint32_t)) return 0;
+    uint32_t count = data[0];
+    if (sizeof(uint32_t) + (size_t)count * sizeof(SymbolEntry) > size) return 0;
+    return (int)count;
+}
+
+const SymbolEntry *bytecode_symbol(BytecodeImage *img, int i, const char **name) {
+    uint32_t size;
+    const uint8_t *data = bytecode_section(img, SECTION_SYMBOLS, &size);
+    int count = bytecode_symbol_count(img);
+    if (!data || i < 0 || i >= count) return NULL;
+
+    const SymbolEntry *entries = (const SymbolEntry *)(data + sizeof(uint32_t));
+    const uint8_t *names = (const uint8_t *)&entries[count];
+    const SymbolEntry *sym = &entries[i];
+    if ((size_t)(names - data) + sym->name_offset + sym->name_len > size) return NULL;
+    if (name) *name = (const char *)names + sym->name_offset;
+    return sym;
+}
+
+const SymbolEntry *bytecode_find_symbol(BytecodeImage *img, const char *name) {
+    size_t len = strlen(name);
+    int count = bytecode_symbol_count(img);
+    for (int i = 0; i < count; i++) {
+        const char *sym_name;
+        const SymbolEntry *sym = bytecode_symbol(img, i, &sym_name);
+        if (sym && sym->name_len == len && memcmp(sym_name, name, len) == 0) return sym;
+    }
+    return NULL;
+}
+
+int bytecode_write(const char *path, uint32_t stack_size, uint32_t heap_size,
+                   const BytecodeSection *sections, int count) {
+    BytecodeHeader hdr;
+    memcpy(hdr.magic, BC_MAGIC, 4);
+    hdr.version = BC_VERSION;
+    hdr.section_count = (uint16_t)count;
+    hdr.stack_size = stack_size;
+    hdr.heap_size = heap_size;
+    hdr.flags = 0;
+
+    SectionEntry *table = calloc(count ? count : 1, sizeof(SectionEntry));
+    if (!table) return -1;
+    uint32_t offset = sizeof(BytecodeHeader) + count * sizeof(SectionEntry);
+    for (int i = 0; i < count; i++) {
+        offset = (offset + BC_ALIGN - 1) & ~(uint32_t)(BC_ALIGN - 1);
+        table[i].type = sections[i].type;
+        table[i].offset = offset;
+        table[i].size = sections[i].size;
+        table[i].checksum = bytecode_checksum(sections[i].data, sections[i].size);
+        offset += sections[i].size;
+    }
+    hdr.table_checksum = bytecode_checksum((const uint8_t *)table, count * sizeof(SectionEntry));
+
+    // Write next to the target and rename, so a running VM never sees a half-written file
+    size_t plen = strlen(path);
+    char *tmp = malloc(plen + sizeof(".tmp"));
+    if (!tmp) { free(table); return -1; }
+    memcpy(tmp, path, plen);
+    strcpy(tmp + plen, ".tmp");
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        perror(tmp);
+        free(tmp);
+        free(table);
+        return -1;
+    }
+    static const uint8_t zeros[BC_ALIGN];
+    int ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    ok = ok && fwrite(table, sizeof(SectionEntry), count, f) == (size_t)count;
+    uint32_t pos = sizeof(hdr) + count * sizeof(SectionEntry);
+    for (int i = 0; i < count && ok; i++) {
+        if (table[i].offset > pos) ok = fwrite(zeros, 1, table[i].offset - pos, f) == table[i].offset - pos;
+        if (sections[i].size) ok = ok && fwrite(sections[i].data, 1, sections[i].size, f) == sections[i].size;
+        pos = table[i].offset + sections[i].size;
+    }
+    if (fclose(f) != 0) ok = 0;
+    if (ok && rename(tmp, path) != 0) {
+        perror(path);
+        ok = 0;
+    }
+    if (!ok) unlink(tmp);
+
+    free(tmp);
+    free(table);
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,124 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Bytecode Container Format (version 2)
+// A .bin file bundles everything the VM needs for one program:
+//
+//   +----------------------+  offset 0
+//   | BytecodeHeader       |  magic "CSVM", version, section count,
+//   |                      |  required stack/heap sizes, table checksum
+//   +----------------------+
+//   | SectionEntry[count]  |  type, offset, size, FNV-1a checksum
+//   +----------------------+
+//   | section payloads     |  each starting on an 8-byte boundary
+//   +----------------------+
+//
+// Only the header, section table and CODE section are validated when the
+// file is loaded. Debug sections (LINES, SYMBOLS) and the cached JIT code
+// are located but not touched until someone asks for them, so a plain run
+// never faults those pages in. All fields are little-endian.
+// Written by src/vm/assembler.py and bytecode_write().
+
+#define BC_MAGIC "CSVM"
+#define BC_VERSION 2
+#define BC_ALIGN 8
+
+enum {
+    SECTION_CODE    = 1,  // Raw bytecode
+    SECTION_LINES   = 2,  // LineEntry[], sorted by address
+    SECTION_SYMBOLS = 3,  // u32 count, SymbolEntry[count], then the name bytes
+    SECTION_JIT     = 4,  // JitCacheHeader + native code (optional)
+};
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t section_count;
+    uint32_t stack_size;      // Operand stack entries the program needs
+    uint32_t heap_size;       // Heap words the program needs
+    uint32_t flags;           // Reserved, 0
+    uint32_t table_checksum;  // FNV-1a over the section table
+} BytecodeHeader;
+
+typedef struct {
+    uint32_t type;
+    uint32_t offset;          // From the start of the file
+    uint32_t size;
+    uint32_t checksum;        // FNV-1a over the payload
+} SectionEntry;
+
+// SECTION_LINES: source line of the instruction starting at `address`
+typedef struct {
+    int32_t address;
+    int32_t line;
+} LineEntry;
+
+// SECTION_SYMBOLS
+enum {
+    SYM_GLOBAL = 1,  // Global variable, value = memory address
+    SYM_FUNC   = 2,  // Function entry point, value = code address
+    SYM_LABEL  = 3,  // Any other label, value = code address
+};
+
+typedef struct {
+    uint32_t kind;
+    int32_t value;
+    uint32_t name_offset;     // Into the name bytes after the entry array
+    uint32_t name_len;
+} SymbolEntry;
+
+// SECTION_JIT: native code produced by compile() for this exact CODE section,
+// by this version of the JIT, for an address space of this size
+typedef struct {
+    uint32_t code_checksum;   // Checksum of the CODE section it was compiled from
+    uint32_t native_size;
+    uint32_t jit_version;     // JIT_VERSION of the compiler that produced it
+    uint32_t mem_words;       // Address space bound compiled into the code
+} JitCacheHeader;
+
+// A loaded program. Everything points straight into one read-only mapping of the file.
+typedef struct {
+    const uint8_t *code;
+    int code_size;
+    uint32_t code_checksum;
+    uint32_t stack_size;
+    uint32_t heap_size;
+    const SectionEntry *sections;
+    int section_count;
+    uint32_t checked_sections; // Bitmask of section types whose checksum has been verified
+    void *map;                 // mmap() base
+    size_t map_size;
+} BytecodeImage;
+
+// Section payload handed to bytecode_write()
+typedef struct {
+    uint32_t type;
+    const void *data;
+    uint32_t size;
+} BytecodeSection;
+
+// Maps `path` (one open, one mmap) and validates the header, section table
+// and CODE section against the VM's capacity. Prints the reason and returns
+// -1 on failure.
+int bytecode_load(const char *path, uint32_t max_stack, uint32_t max_heap, BytecodeImage *img);
+void bytecode_unload(BytecodeImage *img);
+
+// Lazily validated access to an optional section. Returns NULL if the section
+// is absent or its checksum does not match.
+const void *bytecode_section(BytecodeImage *img, uint32_t type, uint32_t *size);
+
+// Symbol lookup helpers over SECTION_SYMBOLS
+int bytecode_symbol_count(BytecodeImage *img);
+const SymbolEntry *bytecode_symbol(BytecodeImage *img, int i, const char **name);
+const SymbolEntry *bytecode_find_symbol(BytecodeImage *img, const char *name);
+
+// Writes a complete container (atomically, through a temporary file)
+int bytecode_write(const char *path, uint32_t stack_size, uint32_t heap_size,
+                   const BytecodeSection *sections, int count);
+
+uint32_t bytecode_checksum(const uint8_t *data, size_t len);
+
+#endif
@@ -0,0 +1,130 @@
+#include "input.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+void input_open_fd(InputStream *in, int fd) {
+    memset(in, 0, sizeof(*in));
+    in->fd = fd;
+    in->tty = isatty(fd);
+}
+
+int input_open_file(InputStream *in, const char *path) {
+    memset(in, 0, sizeof(*in));
+    in->fd = -1;
+    in->eof = 1;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) { // mmap rejects empty files; there is nothing to read anyway
+        close(fd);
+        return 0;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    in->map = map;
+    in->map_size = st.st_size;
+    in->data = map;
+    in->len = st.st_size;
+    return 0;
+}
+
+// Moves the unread bytes to the front of the buffer and reads one chunk after
+// them. Returns the number of bytes read (0 at end of input).
+static size_t fill(InputStream *in) {
+    if (in->eof) return 0;
+    size_t keep = in->len - in->pos;
+    if (in->buf && in->pos > 0) memmove(in->buf, in->buf + in->pos, keep);
+    in->pos = 0;
+    in->len = keep;
+    if (in->cap - in->len < INPUT_CHUNK / 2) { // A token longer than the buffer
+        size_t cap = in->cap ? in->cap * 2 : INPUT_CHUNK;
+        char *buf = realloc(in->buf, cap);
+        if (!buf) { perror("realloc"); exit(1); }
+        in->buf = buf;
+        in->cap = cap;
+    }
+    in->data = in->buf;
+
+    ssize_t n;
+    do n = read(in->fd, in->buf + in->len, in->cap - in->len);
+    while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        in->eof = 1;
+        return 0;
+    }
+    in->len += n;
+    return n;
+}
+
+static void skip_space(InputStream *in) {
+    const char *p = in->data + in->pos, *end = in->data + in->len;
+    while (p < end && (unsigned char)*p <= ' ') in->lines += *p++ == '\n';
+    in->pos = p - in->data;
+}
+
+int input_drained(InputStream *in) {
+    skip_space(in);
+    return in->pos >= in->len;
+}
+
+int input_next_int(InputStream *in, int32_t *out) {
+    for (;;) {
+        skip_space(in);
+        if (in->pos < in->len) break;
+        if (fill(in) == 0) return 0;
+    }
+
+    // Find the end of the token, reading more if it runs into the end of the buffer
+    size_t end = in->pos;
+    for (;;) {
+        while (end < in->len && (unsigned char)in->data[end] > ' ') end++;
+        if (end < in->len || in->eof) break;
+        size_t scanned = end - in->pos;
+        size_t got = fill(in); // Moves the unread bytes to the front
+        end = in->pos + scanned;
+        if (got == 0) break;
+    }
+
+    const char *p = in->data + in->pos, *stop = in->data + end;
+    in->pos = end;
+    int neg = 0;
+    if (*p == '-' || *p == '+') neg = *p++ == '-';
+    if (p == stop) return -1;
+
+    // One unsigned compare per digit; the value wraps like 32-bit arithmetic
+    uint32_t v = 0;
+    for (; p < stop; p++) {
+        uint32_t d = (unsigned char)*p - '0';
+        if (d > 9) return -1;
+        v = v * 10 + d;
+    }
+    *out = (int32_t)(neg ? 0u - v : v);
+    return 1;
+}
+
+void input_close(InputStream *in) {
+    if (in->map) munmap(in->map, in->map_size);
+    free(in->buf);
+    memset(in, 0, sizeof(*in));
+    in->fd = -1;
+}
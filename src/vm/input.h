@@ -0,0 +1,38 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Integer input stream (part of libvm.a)
+// Reads whitespace-separated integers from a file descriptor in large chunks,
+// or from a whole file mapped with mmap, instead of one scanf() per value.
+// Any byte <= ' ' separates tokens; a token is [+-]digits.
+
+#define INPUT_CHUNK 65536
+
+typedef struct {
+    const char *data;      // Unread bytes are data[pos..len)
+    size_t pos, len;
+    char *buf;             // Chunk buffer (fd streams); NULL for a mapping
+    size_t cap;
+    void *map;             // mmap'd file, if any
+    size_t map_size;
+    int fd;                // -1 for a mapping
+    int eof;               // Nothing more will arrive after data[len]
+    int tty;               // fd is a terminal (callers may prompt)
+    long lines;            // Newlines consumed so far
+} InputStream;
+
+// Reads `fd` (not closed by input_close) in INPUT_CHUNK reads
+void input_open_fd(InputStream *in, int fd);
+// Maps `path` read-only. Returns 0, or -1 with a message on stderr.
+int input_open_file(InputStream *in, const char *path);
+// 1: true if no unread token is buffered, so the next input_next_int may block
+int input_drained(InputStream *in);
+// 1 and *out = next integer; 0 at end of input; -1 if the next token is not
+// an integer (the token is skipped)
+int input_next_int(InputStream *in, int32_t *out);
+void input_close(InputStream *in);
+
+#endif
@@ -20,7 +20,135 @@ void emit_int32(uint8_t **ptr, int32_t val) {
     *ptr += 4;
 }
 
-jit_func compile(uint8_t *code, int length) {
+jit_func jit_load(const void *native, size_t size) {
+    if (size > MAX_CODE_SIZE) return NULL;
+    void *mem = mmap(NULL, MAX_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    memcpy(mem, native, size);
+    return (jit_func)mem;
+}
+
+void jit_free(jit_func fn) {
+    if (fn) munmap((void *)fn, MAX_CODE_SIZE);
+}
+
+int jit_stacks_alloc(JitStacks *s) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t frames = (JIT_FRAME_WORDS * sizeof(uint64_t) + page - 1) / page * page;
+    size_t returns = (JIT_RETURN_DEPTH * sizeof(uint64_t) + page - 1) / page * page;
+    // Layout: [frames][guard][returns][guard]
+    s->map_size = frames + page + returns + page;
+    s->map = mmap(NULL, s->map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (s->map == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    uint8_t *base = s->map;
+    if (mprotect(base + frames, page, PROT_NONE) != 0 ||
+        mprotect(base + frames + page + returns, page, PROT_NONE) != 0) {
+        perror("mprotect");
+        munmap(s->map, s->map_size);
+        return -1;
+    }
+    s->frames = (uint64_t *)base;
+    s->returns = (uint64_t *)(base + frames + page);
+    return 0;
+}
+
+void jit_stacks_free(JitStacks *s) {
+    munmap(s->map, s->map_size);
+}
+
+// A rel32 jump displacement waiting for its target's native offset
+typedef struct {
+    int at;      // Offset of the rel32 field in the native buffer
+    int target;  // Bytecode address it must reach
+} JumpFixup;
+
+// Emits the rel32 of a jump. Backward targets are resolved immediately,
+// forward ones are recorded and patched after the whole program is compiled.
+static void emit_rel32(uint8_t **ptr, uint8_t *mem, int target, const int *mapping,
+                       JumpFixup *fixups, int *fixup_count) {
+    int at = (int)(*ptr - mem);
+    if (mapping[target] != -1) {
+        emit_int32(ptr, mapping[target] - (at + 4));
+    } else {
+        fixups[(*fixup_count)++] = (JumpFixup){ at, target };
+        emit_int32(ptr, 0);
+    }
+}
+
+// Epilogue shared by HALT and falling off the end. The callee-saved registers
+// are reloaded relative to rbp, so it works whatever is left on the stack.
+static void emit_epilogue(uint8_t **ptr) {
+    emit_byte(ptr, 0x58); // pop rax (return value)
+    emit_byte(ptr, 0x48); emit_byte(ptr, 0x8B); emit_byte(ptr, 0x5D); emit_byte(ptr, 0xF8); // mov rbx, [rbp-8]
+    emit_byte(ptr, 0x4C); emit_byte(ptr, 0x8B); emit_byte(ptr, 0x65); emit_byte(ptr, 0xF0); // mov r12, [rbp-16]
+    emit_byte(ptr, 0x4C); emit_byte(ptr, 0x8B); emit_byte(ptr, 0x6D); emit_byte(ptr, 0xE8); // mov r13, [rbp-24]
+    emit_byte(ptr, 0x4C); emit_byte(ptr, 0x8B); emit_byte(ptr, 0x75); emit_byte(ptr, 0xE0); // mov r14, [rbp-32]
+    emit_byte(ptr, 0x4C); emit_byte(ptr, 0x8B); emit_byte(ptr, 0x7D); emit_byte(ptr, 0xD8); // mov r15, [rbp-40]
+    emit_byte(ptr, 0xC9); // leave
+    emit_byte(ptr, 0xC3); // ret
+}
+
+// Byte offset of local `i` from the frame base (slot 0 is the saved fp)
+static int local_offset(int32_t i) {
+    return 8 + 8 * i;
+}
+
+// Traps unless the last compare found lhs <= rhs (unsigned, so negatives fail too)
+static void emit_check_below_equal(uint8_t **ptr) {
+    emit_byte(ptr, 0x76); emit_byte(ptr, 0x02); // jbe +2
+    emit_byte(ptr, 0x0F); emit_byte(ptr, 0x0B); // ud2
+}
+
+// With an address in rax: eax += off (wrapping like the VM), then traps unless
+// the result is below mem_words. Writing eax clears the upper half of rax.
+static void emit_index(uint8_t **ptr, int32_t off, int mem_words) {
+    emit_byte(ptr, 0x05); emit_int32(ptr, off);       // add eax, off
+    emit_byte(ptr, 0x3D); emit_int32(ptr, mem_words); // cmp eax, mem_words
+    emit_byte(ptr, 0x72); emit_byte(ptr, 0x02);       // jb +2
+    emit_byte(ptr, 0x0F); emit_byte(ptr, 0x0B);       // ud2
+}
+
+// With n in rcx and two addresses in rsi, rdi: traps unless both [addr, addr + n)
+// lie inside mem_words, then turns them into pointers (rsi/rdi = r15 + 4 * addr)
+static void emit_two_ranges(uint8_t **ptr, int mem_words) {
+    emit_byte(ptr, 0xB8); emit_int32(ptr, mem_words);                 // mov eax, mem_words
+    emit_byte(ptr, 0x48); emit_byte(ptr, 0x39); emit_byte(ptr, 0xC1); // cmp rcx, rax
+    emit_check_below_equal(ptr);
+    emit_byte(ptr, 0x48); emit_byte(ptr, 0x29); emit_byte(ptr, 0xC8); // sub rax, rcx
+    emit_byte(ptr, 0x48); emit_byte(ptr, 0x39); emit_byte(ptr, 0xC6); // cmp rsi, rax
+    emit_check_below_equal(ptr);
+    emit_byte(ptr, 0x48); emit_byte(ptr, 0x39); emit_byte(ptr, 0xC7); // cmp rdi, rax
+    emit_check_below_equal(ptr);
+    emit_byte(ptr, 0x49); emit_byte(ptr, 0x8D); emit_byte(ptr, 0x34); emit_byte(ptr, 0xB7); // lea rsi, [r15+rsi*4]
+    emit_byte(ptr, 0x49); emit_byte(ptr, 0x8D); emit_byte(ptr, 0x3C); emit_byte(ptr, 0xBF); // lea rdi, [r15+rdi*4]
+}
+
+// x86 condition code (low nibble of SETcc 0F 9x / Jcc 0F 8x) for a comparison
+static int condition_code(uint8_t opcode) {
+    switch (opcode) {
+        case EQ: case JEQ: return 0x4; // e
+        case NE: case JNE: return 0x5; // ne
+        case CMP: case JLT: return 0xC; // l
+        case GE: case JGE: return 0xD; // ge
+        case LE: case JLE: return 0xE; // le
+        case GT: case JGT: return 0xF; // g
+        default: return -1;
+    }
+}
+
+jit_func compile(const uint8_t *code, int length, int mem_words, size_t *native_size) {
+    if (length > MAX_CODE_SIZE) {
+        fprintf(stderr, "JIT Error: program too large (%d bytes of bytecode)\n", length);
+        return NULL;
+    }
+
     // 1. Allocate executable memory
     void *mem = mmap(NULL, MAX_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
@@ -39,22 +167,40 @@ jit_func compile(uint8_t *code, int length) {
     emit_byte(&ptr, 0x48);
     emit_byte(&ptr, 0x89);
     emit_byte(&ptr, 0xE5);
-    // push rbx (callee-saved)
+    // push rbx; push r12; push r13; push r14; push r15 (callee-saved)
     emit_byte(&ptr, 0x53);
+    emit_byte(&ptr, 0x41); emit_byte(&ptr, 0x54);
+    emit_byte(&ptr, 0x41); emit_byte(&ptr, 0x55);
+    emit_byte(&ptr, 0x41); emit_byte(&ptr, 0x56);
+    emit_byte(&ptr, 0x41); emit_byte(&ptr, 0x57);
+    // Frame registers: r12 = fp, r13 = frame top, r14 = return stack pointer,
+    // r15 = memory base
+    // mov r12, rdi; mov r13, rdi; mov r14, rsi; mov r15, rdx
+    emit_byte(&ptr, 0x49); emit_byte(&ptr, 0x89); emit_byte(&ptr, 0xFC);
+    emit_byte(&ptr, 0x49); emit_byte(&ptr, 0x89); emit_byte(&ptr, 0xFD);
+    emit_byte(&ptr, 0x49); emit_byte(&ptr, 0x89); emit_byte(&ptr, 0xF6);
+    emit_byte(&ptr, 0x49); emit_byte(&ptr, 0x89); emit_byte(&ptr, 0xD7);
 
     // Map from bytecode offset to machine code offset
     int mapping[MAX_CODE_SIZE];
     for (int i = 0; i < MAX_CODE_SIZE; i++) mapping[i] = -1;
+    JumpFixup fixups[MAX_CODE_SIZE / 5 + 1]; // At most one per 5-byte jump
+    int fixup_count = 0;
 
     while (pc < length) {
-        int current_pc = pc;
+        // Worst case below is ~65 bytes (MEMCPY), plus the epilogue
+        if ((uint8_t *)ptr - (uint8_t *)mem > MAX_CODE_SIZE - 96) {
+            fprintf(stderr, "JIT Error: native code exceeds %d bytes\n", MAX_CODE_SIZE);
+            munmap(mem, MAX_CODE_SIZE);
+            return NULL;
+        }
         mapping[pc] = (int)((uint8_t*)ptr - (uint8_t*)mem);
         
         uint8_t opcode = code[pc++];
 
         switch (opcode) {
             case PUSH: {
-                int32_t val = *(int32_t *)&code[pc];
+                int32_t val = *(const int32_t *)&code[pc];
                 pc += 4;
                 emit_byte(&ptr, 0x68);
                 emit_int32(&ptr, val);
@@ -94,7 +240,8 @@ jit_func compile(uint8_t *code, int length) {
                 emit_byte(&ptr, 0x50);
                 break;
             }
-            case CMP: {
+            case CMP:
+            case EQ: case NE: case LE: case GT: case GE: {
                // pop rbx (second)
                 emit_byte(&ptr, 0x5B);
                 // pop rax (first)
@@ -105,10 +252,10 @@ jit_func compile(uint8_t *code, int length) {
                 emit_byte(&ptr, 0x39);
                 emit_byte(&ptr, 0xD8);
                 
-                // setl al (set if less) - VM CMP is: (a < b) ? 1 : 0
+                // setcc al - e.g. setl for CMP: (a < b) ? 1 : 0
                 emit_byte(&ptr, 0x0F); 
-                emit_byte(&ptr, 0x9C); 
-                emit_byte(&ptr, 0xC0); // setl al
+                emit_byte(&ptr, 0x90 | condition_code(opcode)); 
+                emit_byte(&ptr, 0xC0);
                 
                 // movzx rax, al (zero extend to 64-bit)
                 emit_byte(&ptr, 0x48);
@@ -120,87 +267,263 @@ jit_func compile(uint8_t *code, int length) {
                 emit_byte(&ptr, 0x50);
                 break;
             }
-            // Control Flow
+            // Control Flow (forward targets are patched after the loop)
             case JMP: {
-                int32_t target = *(int32_t *)&code[pc];
+                int32_t target = *(const int32_t *)&code[pc];
                 pc += 4;
-                // For simplified JIT, assuming backward jump to existing code (e.g. for loop)
-                if (target < current_pc && mapping[target] != -1) {
-                    // jmp rel32 (E9 rel32)
-                    int current_offset = (int)((uint8_t*)ptr - (uint8_t*)mem);
-                    int target_offset = mapping[target];
-                    int rel32 = target_offset - (current_offset + 5);
-                    emit_byte(&ptr, 0xE9);
-                    emit_int32(&ptr, rel32);
-                } else {
-                    fprintf(stderr, "JIT Error: Forward/Unknown JMP not implemented yet\n");
+                if (target < 0 || target >= length) {
+                    fprintf(stderr, "JIT Error: JMP target %d out of range\n", target);
+                    munmap(mem, MAX_CODE_SIZE);
                     return NULL;
                 }
+                // jmp rel32 (E9 rel32)
+                emit_byte(&ptr, 0xE9);
+                emit_rel32(&ptr, mem, target, mapping, fixups, &fixup_count);
                 break;
             }
-            case JZ: {
-                int32_t target = *(int32_t *)&code[pc];
+            case JZ:
+            case JNZ: {
+                int32_t target = *(const int32_t *)&code[pc];
                 pc += 4;
+                if (target < 0 || target >= length) {
+                    fprintf(stderr, "JIT Error: branch target %d out of range\n", target);
+                    munmap(mem, MAX_CODE_SIZE);
+                    return NULL;
+                }
                 // pop rax
                 emit_byte(&ptr, 0x58);
                 // test rax, rax (48 85 C0)
                 emit_byte(&ptr, 0x48); emit_byte(&ptr, 0x85); emit_byte(&ptr, 0xC0);
-                
-                if (target < current_pc && mapping[target] != -1) {
-                    // je rel32 (0F 84 rel32)
-                    int current_offset = (int)((uint8_t*)ptr - (uint8_t*)mem);
-                    int target_offset = mapping[target];
-                    int rel32 = target_offset - (current_offset + 6); // 2 bytes opcode + 4 bytes rel
-                    emit_byte(&ptr, 0x0F);
-                    emit_byte(&ptr, 0x84);
-                    emit_int32(&ptr, rel32);
-                } else {
-                    fprintf(stderr, "JIT Error: Forward/Unknown JZ not implemented\n");
+                // je/jne rel32 (0F 84 / 0F 85 rel32)
+                emit_byte(&ptr, 0x0F);
+                emit_byte(&ptr, opcode == JZ ? 0x84 : 0x85);
+                emit_rel32(&ptr, mem, target, mapping, fixups, &fixup_count);
+                break;
+            }
+            case JEQ: case JNE: case JLT: case JLE: case JGT: case JGE: {
+                int32_t target = *(const int32_t *)&code[pc];
+                pc += 4;
+                if (target < 0 || target >= length) {
+                    fprintf(stderr, "JIT Error: branch target %d out of range\n", target);
+                    munmap(mem, MAX_CODE_SIZE);
+                    return NULL;
+                }
+                // pop rbx; pop rax; cmp rax, rbx
+                emit_byte(&ptr, 0x5B);
+                emit_byte(&ptr, 0x58);
+                emit_byte(&ptr, 0x48); emit_byte(&ptr, 0x39); emit_byte(&ptr, 0xD8);
+                // jcc rel32 (0F 8x rel32)
+                emit_byte(&ptr, 0x0F);
+                emit_byte(&ptr, 0x80 | condition_code(opcode));
+                emit_rel32(&ptr, mem, target, mapping, fixups, &fixup_count);
+                break;
+            }
+
+            // Calls keep their return addresses on a separate stack (r14), like
+            // the interpreter's return_stack, so the operand stack stays intact
+            case CALL: {
+                int32_t target = *(const int32_t *)&code[pc];
+                pc += 4;
+                if (target < 0 || target >= length) {
+                    fprintf(stderr, "JIT Error: CALL target %d out of range\n", target);
+                    munmap(mem, MAX_CODE_SIZE);
                     return NULL;
                 }
+                // lea rax, [rip+12] (address after this sequence)
+                emit_byte(&ptr, 0x48); emit_byte(&ptr, 0x8D); emit_byte(&ptr, 0x05); emit_int32(&ptr, 12);
+                // mov [r14], rax; add r14, 8
+                emit_byte(&ptr, 0x49); emit_byte(&ptr, 0x89); emit_byte(&ptr, 0x06);
+                emit_byte(&ptr, 0x49); emit_byte(&ptr, 0x83); emit_byte(&ptr, 0xC6); emit_byte(&ptr, 0x08);
+                // jmp rel32
+                emit_byte(&ptr, 0xE9);
+                emit_rel32(&ptr, mem, target, mapping, fixups, &fixup_count);
                 break;
             }
-            case JNZ: {
-                int32_t target = *(int32_t *)&code[pc];
+            case RET: {
+                // sub r14, 8; jmp [r14]
+                emit_byte(&ptr, 0x49); emit_byte(&ptr, 0x83); emit_byte(&ptr, 0xEE); emit_byte(&ptr, 0x08);
+                emit_byte(&ptr, 0x41); emit_byte(&ptr, 0xFF); emit_byte(&ptr, 0x26);
+                break;
+            }
+            case ENTER: {
+                int32_t n = *(const int32_t *)&code[pc];
                 pc += 4;
-                // pop rax
-                emit_byte(&ptr, 0x58);
-                // test rax, rax
-                emit_byte(&ptr, 0x48); emit_byte(&ptr, 0x85); emit_byte(&ptr, 0xC0);
-                
-                if (target < current_pc && mapping[target] != -1) {
-                    // jne rel32 (0F 85 rel32)
-                    int current_offset = (int)((uint8_t*)ptr - (uint8_t*)mem);
-                    int target_offset = mapping[target];
-                    int rel32 = target_offset - (current_offset + 6);
-                    emit_byte(&ptr, 0x0F);
-                    emit_byte(&ptr, 0x85);
-                    emit_int32(&ptr, rel32);
+                if (n < 0 || n >= JIT_FRAME_WORDS) {
+                    fprintf(stderr, "JIT Error: ENTER %d exceeds the frame stack\n", n);
+                    munmap(mem, MAX_CODE_SIZE);
+                    return NULL;
+                }
+                // mov [r13], r12 (link to the caller's frame); mov r12, r13
+                emit_byte(&ptr, 0x4D); emit_byte(&ptr, 0x89); emit_byte(&ptr, 0x65); emit_byte(&ptr, 0x00);
+                emit_byte(&ptr, 0x4D); emit_byte(&ptr, 0x89); emit_byte(&ptr, 0xEC);
+                // add r13, 8 * (n + 1)
+                emit_byte(&ptr, 0x49); emit_byte(&ptr, 0x81); emit_byte(&ptr, 0xC5); emit_int32(&ptr, local_offset(n));
+                // Locals start at 0, as in the interpreter (the slots may hold an old frame)
+                if (n == 0) break;
+                emit_byte(&ptr, 0x31); emit_byte(&ptr, 0xC0);                         // xor eax, eax
+                if (n <= 8) {
+                    for (int i = 0; i < n; i++) {
+                        // mov [r12 + disp8], rax
+                        emit_byte(&ptr, 0x49); emit_byte(&ptr, 0x89); emit_byte(&ptr, 0x44); emit_byte(&ptr, 0x24);
+                        emit_byte(&ptr, (uint8_t)local_offset(i));
+                    }
                 } else {
-                    fprintf(stderr, "JIT Error: Forward/Unknown JNZ not implemented\n");
+                    // lea rdi, [r12 + 8]; mov ecx, n; rep stosq
+                    emit_byte(&ptr, 0x49); emit_byte(&ptr, 0x8D); emit_byte(&ptr, 0x7C); emit_byte(&ptr, 0x24); emit_byte(&ptr, 0x08);
+                    emit_byte(&ptr, 0xB9); emit_int32(&ptr, n);
+                    emit_byte(&ptr, 0xF3); emit_byte(&ptr, 0x48); emit_byte(&ptr, 0xAB);
+                }
+                break;
+            }
+            case LEAVE: {
+                // mov r13, r12; mov r12, [r13]
+                emit_byte(&ptr, 0x4D); emit_byte(&ptr, 0x89); emit_byte(&ptr, 0xE5);
+                emit_byte(&ptr, 0x4D); emit_byte(&ptr, 0x8B); emit_byte(&ptr, 0x65); emit_byte(&ptr, 0x00);
+                break;
+            }
+            case TAILCALL: {
+                int32_t target = *(const int32_t *)&code[pc];
+                pc += 4;
+                if (target < 0 || target >= length) {
+                    fprintf(stderr, "JIT Error: TAILCALL target %d out of range\n", target);
+                    munmap(mem, MAX_CODE_SIZE);
                     return NULL;
                 }
+                // LEAVE (mov r13, r12; mov r12, [r13]), then jmp rel32
+                emit_byte(&ptr, 0x4D); emit_byte(&ptr, 0x89); emit_byte(&ptr, 0xE5);
+                emit_byte(&ptr, 0x4D); emit_byte(&ptr, 0x8B); emit_byte(&ptr, 0x65); emit_byte(&ptr, 0x00);
+                emit_byte(&ptr, 0xE9);
+                emit_rel32(&ptr, mem, target, mapping, fixups, &fixup_count);
+                break;
+            }
+            case LOAD_LOCAL:
+            case STORE_LOCAL: {
+                int32_t i = *(const int32_t *)&code[pc];
+                pc += 4;
+                if (i < 0 || i >= JIT_FRAME_WORDS) {
+                    fprintf(stderr, "JIT Error: local %d out of range\n", i);
+                    munmap(mem, MAX_CODE_SIZE);
+                    return NULL;
+                }
+                // push qword [r12+disp32] (41 FF B4 24) / pop qword [r12+disp32] (41 8F 84 24)
+                emit_byte(&ptr, 0x41);
+                emit_byte(&ptr, opcode == LOAD_LOCAL ? 0xFF : 0x8F);
+                emit_byte(&ptr, opcode == LOAD_LOCAL ? 0xB4 : 0x84);
+                emit_byte(&ptr, 0x24);
+                emit_int32(&ptr, local_offset(i));
+                break;
+            }
+
+            // Globals and heap: r15 points at word 0 of the address space
+            case LOAD:
+            case STORE: {
+                int32_t addr = *(const int32_t *)&code[pc];
+                pc += 4;
+                if (addr < 0 || addr >= mem_words) {
+                    fprintf(stderr, "JIT Error: address %d out of range\n", addr);
+                    munmap(mem, MAX_CODE_SIZE);
+                    return NULL;
+                }
+                if (opcode == LOAD) {
+                    // movsxd rax, dword [r15+disp32]; push rax
+                    emit_byte(&ptr, 0x49); emit_byte(&ptr, 0x63); emit_byte(&ptr, 0x87); emit_int32(&ptr, addr * 4);
+                    emit_byte(&ptr, 0x50);
+                } else {
+                    // pop rax; mov dword [r15+disp32], eax
+                    emit_byte(&ptr, 0x58);
+                    emit_byte(&ptr, 0x41); emit_byte(&ptr, 0x89); emit_byte(&ptr, 0x87); emit_int32(&ptr, addr * 4);
+                }
+                break;
+            }
+            case LOADI:
+            case STOREI: {
+                int32_t off = *(const int32_t *)&code[pc];
+                pc += 4;
+                if (opcode == LOADI) {
+                    // pop rax; check; movsxd rax, dword [r15+rax*4]; push rax
+                    emit_byte(&ptr, 0x58);
+                    emit_index(&ptr, off, mem_words);
+                    emit_byte(&ptr, 0x49); emit_byte(&ptr, 0x63); emit_byte(&ptr, 0x04); emit_byte(&ptr, 0x87);
+                    emit_byte(&ptr, 0x50);
+                } else {
+                    // pop rcx (value); pop rax; check; mov dword [r15+rax*4], ecx
+                    emit_byte(&ptr, 0x59); emit_byte(&ptr, 0x58);
+                    emit_index(&ptr, off, mem_words);
+                    emit_byte(&ptr, 0x41); emit_byte(&ptr, 0x89); emit_byte(&ptr, 0x0C); emit_byte(&ptr, 0x87);
+                }
+                break;
+            }
+            // Bulk memory: one range check, then a string instruction
+            case MEMCPY: {
+                // pop rcx (n); pop rsi (src); pop rdi (dst)
+                emit_byte(&ptr, 0x59); emit_byte(&ptr, 0x5E); emit_byte(&ptr, 0x5F);
+                emit_two_ranges(&ptr, mem_words);
+                // Overlapping with dst above src: copy from the end (memmove)
+                emit_byte(&ptr, 0x48); emit_byte(&ptr, 0x39); emit_byte(&ptr, 0xF7); // cmp rdi, rsi
+                emit_byte(&ptr, 0x76); emit_byte(&ptr, 0x10);                         // jbe forward
+                emit_byte(&ptr, 0x48); emit_byte(&ptr, 0x8D); emit_byte(&ptr, 0x74); emit_byte(&ptr, 0x8E); emit_byte(&ptr, 0xFC); // lea rsi, [rsi+rcx*4-4]
+                emit_byte(&ptr, 0x48); emit_byte(&ptr, 0x8D); emit_byte(&ptr, 0x7C); emit_byte(&ptr, 0x8F); emit_byte(&ptr, 0xFC); // lea rdi, [rdi+rcx*4-4]
+                emit_byte(&ptr, 0xFD);                                                // std
+                emit_byte(&ptr, 0xF3); emit_byte(&ptr, 0xA5);                         // rep movsd
+                emit_byte(&ptr, 0xFC);                                                // cld
+                emit_byte(&ptr, 0xEB); emit_byte(&ptr, 0x02);                         // jmp done
+                emit_byte(&ptr, 0xF3); emit_byte(&ptr, 0xA5);                         // forward: rep movsd
+                break;
+            }
+            case MEMSET: {
+                // pop rcx (n); pop rax (value); pop rdi (dst)
+                emit_byte(&ptr, 0x59); emit_byte(&ptr, 0x58); emit_byte(&ptr, 0x5F);
+                emit_byte(&ptr, 0xBA); emit_int32(&ptr, mem_words);                   // mov edx, mem_words
+                emit_byte(&ptr, 0x48); emit_byte(&ptr, 0x39); emit_byte(&ptr, 0xD1); // cmp rcx, rdx
+                emit_check_below_equal(&ptr);
+                emit_byte(&ptr, 0x48); emit_byte(&ptr, 0x29); emit_byte(&ptr, 0xCA); // sub rdx, rcx
+                emit_byte(&ptr, 0x48); emit_byte(&ptr, 0x39); emit_byte(&ptr, 0xD7); // cmp rdi, rdx
+                emit_check_below_equal(&ptr);
+                emit_byte(&ptr, 0x49); emit_byte(&ptr, 0x8D); emit_byte(&ptr, 0x3C); emit_byte(&ptr, 0xBF); // lea rdi, [r15+rdi*4]
+                emit_byte(&ptr, 0xF3); emit_byte(&ptr, 0xAB);                         // rep stosd
+                break;
+            }
+            case MEMCMP: {
+                // pop rcx (n); pop rdi (b); pop rsi (a)
+                emit_byte(&ptr, 0x59); emit_byte(&ptr, 0x5F); emit_byte(&ptr, 0x5E);
+                emit_two_ranges(&ptr, mem_words);
+                emit_byte(&ptr, 0x31); emit_byte(&ptr, 0xC0);                         // xor eax, eax
+                emit_byte(&ptr, 0x48); emit_byte(&ptr, 0x85); emit_byte(&ptr, 0xC9); // test rcx, rcx
+                emit_byte(&ptr, 0x74); emit_byte(&ptr, 0x10);                         // jz done
+                emit_byte(&ptr, 0xF3); emit_byte(&ptr, 0xA7);                         // repe cmpsd ([rsi] - [rdi])
+                emit_byte(&ptr, 0x74); emit_byte(&ptr, 0x0C);                         // je done
+                emit_byte(&ptr, 0x0F); emit_byte(&ptr, 0x9F); emit_byte(&ptr, 0xC0); // setg al
+                emit_byte(&ptr, 0x48); emit_byte(&ptr, 0x0F); emit_byte(&ptr, 0xB6); emit_byte(&ptr, 0xC0); // movzx rax, al
+                emit_byte(&ptr, 0x48); emit_byte(&ptr, 0x8D); emit_byte(&ptr, 0x44); emit_byte(&ptr, 0x00); emit_byte(&ptr, 0xFF); // lea rax, [rax+rax-1]
+                emit_byte(&ptr, 0x50);                                                // done: push rax
                 break;
             }
 
             case HALT: {
-                emit_byte(&ptr, 0x58); // pop rax (return value)
-                emit_byte(&ptr, 0x5B); // pop rbx (restore)
-                emit_byte(&ptr, 0xC9); // leave
-                emit_byte(&ptr, 0xC3); // ret
-                return (jit_func)mem;
+                emit_epilogue(&ptr);
+                break;
             }
             default:
                 fprintf(stderr, "JIT Error: Unsupported opcode 0x%02X\n", opcode);
+                munmap(mem, MAX_CODE_SIZE);
                 return NULL;
         }
     }
     
     // Fallback Epilogue
-    emit_byte(&ptr, 0x58); // pop rax
-    emit_byte(&ptr, 0x5B); // pop rbx
-    emit_byte(&ptr, 0xC9);
-    emit_byte(&ptr, 0xC3);
+    emit_epilogue(&ptr);
+
+    // Resolve forward jumps now that every instruction has native code
+    for (int i = 0; i < fixup_count; i++) {
+        int target_offset = mapping[fixups[i].target];
+        if (target_offset == -1) {
+            fprintf(stderr, "JIT Error: jump into the middle of an instruction (%d)\n", fixups[i].target);
+            munmap(mem, MAX_CODE_SIZE);
+            return NULL;
+        }
+        *(int32_t *)((uint8_t *)mem + fixups[i].at) = target_offset - (fixups[i].at + 4);
+    }
 
+    if (native_size) *native_size = ptr - (uint8_t *)mem;
     return (jit_func)mem;
 }
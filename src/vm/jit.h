@@ -5,11 +5,44 @@
 #include <stdint.h>
 #include <stddef.h>
 
-// Function pointer type for the JIT-compiled code
-typedef int (*jit_func)();
+// Function pointer type for the JIT-compiled code. `frames` backs ENTER/LEAVE
+// and LOAD_LOCAL/STORE_LOCAL, `returns` holds the return addresses of CALL,
+// `mem` is the VM's address space (globals, then heap) for LOAD/STORE,
+// LOADI/STOREI and the bulk memory opcodes.
+typedef int (*jit_func)(uint64_t *frames, uint64_t *returns, int32_t *mem);
 
-// Compile bytecode into machine code
-// Returns a pointer to the executable memory
-jit_func compile(uint8_t *code, int length);
+// Native stacks for jitted code, each followed by a PROT_NONE guard page so
+// runaway recursion faults instead of overwriting memory
+#define JIT_FRAME_WORDS 4096
+#define JIT_RETURN_DEPTH 256
+
+typedef struct {
+    uint64_t *frames;
+    uint64_t *returns;
+    void *map;
+    size_t map_size;
+} JitStacks;
+
+int jit_stacks_alloc(JitStacks *s);
+void jit_stacks_free(JitStacks *s);
+
+// Version of the generated code, stored with cached native code. Bump it
+// whenever compile() emits anything differently, so old caches are ignored.
+#define JIT_VERSION 2
+
+// Compile bytecode into machine code for an address space of `mem_words` words
+// Returns a pointer to the executable memory. If native_size is not NULL it
+// receives the number of machine code bytes emitted.
+// The generated code is position independent, so it can be cached and reloaded.
+// An indirect address (LOADI/STOREI) or bulk memory range outside `mem`
+// executes ud2 (SIGILL) rather than corrupting memory, as the guard pages do
+// for the stacks.
+jit_func compile(const uint8_t *code, int length, int mem_words, size_t *native_size);
+
+// Map previously generated machine code (e.g. from a SECTION_JIT cache) as executable
+jit_func jit_load(const void *native, size_t size);
+
+// Unmap code returned by compile() or jit_load() (NULL is ignored)
+void jit_free(jit_func fn);
 
 #endif
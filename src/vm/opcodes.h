@@ -13,22 +13,63 @@
 #define SUB  0x11
 #define MUL  0x12
 #define DIV  0x13
-#define CMP  0x14
+#define CMP  0x14 // Less than: push (a < b)
+
+// Comparisons: pop b, pop a, push 1 if (a OP b) else 0
+#define LT   CMP  // Alias, same opcode
+#define EQ   0x15
+#define NE   0x16
+#define LE   0x17
+#define GT   0x18
+#define GE   0x19
 
 // Control Flow
 #define JMP  0x20
 #define JZ   0x21
 #define JNZ  0x22
 
+// Fused compare-and-branch: pop b, pop a, jump if (a OP b)
+#define JEQ  0x23
+#define JNE  0x24
+#define JLT  0x25
+#define JLE  0x26
+#define JGT  0x27
+#define JGE  0x28
+
 // Memory & Functions
 #define STORE 0x30
 #define LOAD  0x31
 #define CALL  0x40
 #define RET   0x41
 
+// Call frames: ENTER n pushes a frame with n local slots, LEAVE pops it.
+// LOAD_LOCAL/STORE_LOCAL address slot i of the current frame.
+#define LOAD_LOCAL  0x32
+#define STORE_LOCAL 0x33
+// Indirect access through an address on the stack (heap objects, arrays).
+// The operand is a word offset added to the address, e.g. a field index:
+//   LOADI off:  pop addr, push space[addr + off]
+//   STOREI off: pop val, pop addr, space[addr + off] = val
+#define LOADI       0x34
+#define STOREI      0x35
+#define ENTER       0x42
+#define LEAVE       0x43
+// TAILCALL addr: LEAVE + JMP addr. The callee reuses the caller's frame space
+// and return address, so tail recursion runs in constant space.
+#define TAILCALL    0x44
+
 // Standard Library
 #define PRINT 0x50
 #define INPUT 0x51
 #define ALLOC 0x60
 
+// Bulk memory over the unified address space (globals at 0, heap at
+// MEM_SIZE). Operands are popped n first:
+//   MEMCPY: dst src n  -> copies n words (overlap allowed)
+//   MEMSET: dst val n  -> stores val into n words
+//   MEMCMP: a b n      -> pushes -1, 0 or 1 (first differing word, signed)
+#define MEMCPY 0x61
+#define MEMSET 0x62
+#define MEMCMP 0x63
+
 #endif
@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "sched.h"
+
+// See sched.h. Locking:
+//   - each RunQueue has its own mutex (owner pops the front, thieves pop the back)
+//   - Scheduler.lock guards parked tasks, undelivered input, `live` and the
+//     sleep/wake condition; it is never held while a VM runs
+//   - `runnable` is an atomic hint for idle workers; it is raised before the
+//     wake-up broadcast (under the lock), so a sleeping worker cannot miss a push
+
+typedef struct {
+    VM *vm;
+    VMIO io;               // io.inputs points at `inputs`
+    int32_t *inputs;
+    int input_cap;
+    int id;
+    int next_waiter;       // Next parked task in the FIFO, -1 at the end
+} Task;
+
+typedef struct {
+    pthread_mutex_t lock;
+    int *items;            // Ring of task ids
+    int head, count, cap;
+} RunQueue;
+
+struct Scheduler {
+    Task **tasks;
+    int task_count, task_cap;
+    RunQueue *queues;
+    int threads;
+    long long quantum;
+    SchedOutputFn output;
+    void *ctx;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t hungry; // A task parked, or the last task finished
+    int runnable;          // Tasks sitting in run queues (atomic)
+    int live;              // Tasks that have not finished
+    int failed;
+    int waiter_head, waiter_tail; // Parked tasks, in the order they blocked
+    int32_t *pending;      // Input that arrived while nobody was waiting
+    int pending_head, pending_count, pending_cap;
+    int input_closed;
+    int next_queue;        // Round-robin target for woken tasks
+};
+
+typedef struct {
+    Scheduler *s;
+    int id;
+} WorkerArg;
+
+static void rq_push(RunQueue *q, int id) {
+    pthread_mutex_lock(&q->lock);
+    q->items[(q->head + q->count++) % q->cap] = id;
+    pthread_mutex_unlock(&q->lock);
+}
+
+static int rq_pop(RunQueue *q, int steal) {
+    int id = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->count > 0) {
+        if (steal) {
+            id = q->items[(q->head + q->count - 1) % q->cap];
+        } else {
+            id = q->items[q->head];
+            q->head = (q->head + 1) % q->cap;
+        }
+        q->count--;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return id;
+}
+
+// Makes `t` runnable on queue `qi` and wakes an idle worker
+static void make_runnable(Scheduler *s, Task *t, int qi) {
+    rq_push(&s->queues[qi], t->id);
+    __atomic_add_fetch(&s->runnable, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&s->lock);
+    pthread_cond_signal(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+}
+
+// Only called for a parked task. Values the VM has already read are dropped
+// first, so `inputs` holds what is still unread instead of every value ever fed.
+static void task_give_input(Task *t, int32_t value) {
+    if (t->io.input_pos > 0) {
+        int unread = t->io.input_count - t->io.input_pos;
+        memmove(t->inputs, t->inputs + t->io.input_pos, unread * sizeof(int32_t));
+        t->io.input_count = unread;
+        t->io.input_pos = 0;
+    }
+    if (t->io.input_count == t->input_cap) {
+        t->input_cap = t->input_cap ? t->input_cap * 2 : 16;
+        t->inputs = realloc(t->inputs, t->input_cap * sizeof(int32_t));
+        if (!t->inputs) { perror("realloc"); exit(1); }
+    }
+    t->inputs[t->io.input_count++] = value;
+    t->io.inputs = t->inputs;
+}
+
+Scheduler *sched_create(int threads, long long quantum, SchedOutputFn output, void *ctx) {
+    Scheduler *s = calloc(1, sizeof(Scheduler));
+    if (!s) return NULL;
+    s->threads = threads > 0 ? threads : 1;
+    s->quantum = quantum > 0 ? quantum : 10000;
+    s->output = output;
+    s->ctx = ctx;
+    s->waiter_head = s->waiter_tail = -1;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->wake, NULL);
+    pthread_cond_init(&s->hungry, NULL);
+    return s;
+}
+
+int sched_spawn(Scheduler *s, VM *vm) {
+    if (s->task_count == s->task_cap) {
+        int cap = s->task_cap ? s->task_cap * 2 : 64;
+        Task **tasks = realloc(s->tasks, cap * sizeof(Task *));
+        if (!tasks) return -1;
+        s->tasks = tasks;
+        s->task_cap = cap;
+    }
+    Task *t = calloc(1, sizeof(Task));
+    if (!t) return -1;
+    t->vm = vm;
+    t->id = s->task_count;
+    t->next_waiter = -1;
+    t->io.input_open = 1;
+    vm_set_io(vm, &t->io);
+    s->tasks[s->task_count++] = t;
+    s->live++;
+    return t->id;
+}
+
+void sched_feed(Scheduler *s, int32_t value) {
+    pthread_mutex_lock(&s->lock);
+    if (s->waiter_head >= 0) {
+        Task *t = s->tasks[s->waiter_head];
+        s->waiter_head = t->next_waiter;
+        if (s->waiter_head < 0) s->waiter_tail = -1;
+        task_give_input(t, value); // Parked, so no thread is running it
+        int qi = s->next_queue++ % s->threads;
+        pthread_mutex_unlock(&s->lock);
+        make_runnable(s, t, qi);
+        return;
+    }
+    if (s->pending_head + s->pending_count == s->pending_cap) {
+        if (s->pending_head > 0) {
+            memmove(s->pending, s->pending + s->pending_head, s->pending_count * sizeof(int32_t));
+            s->pending_head = 0;
+        } else {
+            s->pending_cap = s->pending_cap ? s->pending_cap * 2 : 256;
+            s->pending = realloc(s->pending, s->pending_cap * sizeof(int32_t));
+            if (!s->pending) { perror("realloc"); exit(1); }
+        }
+    }
+    s->pending[s->pending_head + s->pending_count++] = value;
+    pthread_mutex_unlock(&s->lock);
+}
+
+int sched_wait_input(Scheduler *s) {
+    pthread_mutex_lock(&s->lock);
+    while (s->waiter_head < 0 && s->live > 0) pthread_cond_wait(&s->hungry, &s->lock);
+    int hungry = s->waiter_head >= 0;
+    pthread_mutex_unlock(&s->lock);
+    return hungry;
+}
+
+void sched_close_input(Scheduler *s) {
+    pthread_mutex_lock(&s->lock);
+    s->input_closed = 1;
+    int w = s->waiter_head;
+    s->waiter_head = s->waiter_tail = -1;
+    pthread_mutex_unlock(&s->lock);
+
+    // Parked tasks resume and fail their INPUT
+    while (w >= 0) {
+        Task *t = s->tasks[w];
+        w = t->next_waiter;
+        t->io.input_open = 0;
+        make_runnable(s, t, t->id % s->threads);
+    }
+}
+
+// `t` stopped at an INPUT with nothing to read
+static void park(Scheduler *s, Task *t, int self) {
+    pthread_mutex_lock(&s->lock);
+    if (s->pending_count > 0) {
+        task_give_input(t, s->pending[s->pending_head++]);
+        s->pending_count--;
+    } else if (s->input_closed) {
+        t->io.input_open = 0;
+    } else {
+        t->next_waiter = -1;
+        if (s->waiter_tail >= 0) s->tasks[s->waiter_tail]->next_waiter = t->id;
+        else s->waiter_head = t->id;
+        s->waiter_tail = t->id;
+        pthread_cond_signal(&s->hungry);
+        pthread_mutex_unlock(&s->lock);
+        return; // sched_feed / sched_close_input requeue it
+    }
+    pthread_mutex_unlock(&s->lock);
+    make_runnable(s, t, self);
+}
+
+static Task *next_task(Scheduler *s, int self) {
+    int id = rq_pop(&s->queues[self], 0);
+    for (int k = 1; id < 0 && k < s->threads; k++) id = rq_pop(&s->queues[(self + k) % s->threads], 1);
+    if (id < 0) return NULL;
+    __atomic_sub_fetch(&s->runnable, 1, __ATOMIC_SEQ_CST);
+    return s->tasks[id];
+}
+
+static void *worker(void *arg) {
+    Scheduler *s = ((WorkerArg *)arg)->s;
+    int self = ((WorkerArg *)arg)->id;
+
+    for (;;) {
+        Task *t = next_task(s, self);
+        if (!t) {
+            pthread_mutex_lock(&s->lock);
+            while (s->live > 0 && __atomic_load_n(&s->runnable, __ATOMIC_SEQ_CST) <= 0)
+                pthread_cond_wait(&s->wake, &s->lock);
+            int done = s->live == 0;
+            pthread_mutex_unlock(&s->lock);
+            if (done) break;
+            continue;
+        }
+
+        VMStatus st = vm_run(t->vm, s->quantum);
+        if (t->io.out_len) {
+            if (s->output) s->output(s->ctx, t->id, t->io.out, t->io.out_len);
+            t->io.out_len = 0;
+        }
+
+        if (st == VM_YIELD) {
+            make_runnable(s, t, self); // Back of our own queue: round-robin
+        } else if (st == VM_BLOCKED) {
+            park(s, t, self);
+        } else {
+            pthread_mutex_lock(&s->lock);
+            if (st == VM_ERROR) s->failed++;
+            if (--s->live == 0) {
+                pthread_cond_broadcast(&s->wake);
+                pthread_cond_broadcast(&s->hungry);
+            }
+            pthread_mutex_unlock(&s->lock);
+        }
+    }
+    return NULL;
+}
+
+int sched_run(Scheduler *s) {
+    if (s->task_count == 0) return 0;
+    if (s->threads > s->task_count) s->threads = s->task_count;
+
+    s->queues = calloc(s->threads, sizeof(RunQueue));
+    pthread_t *tids = calloc(s->threads, sizeof(pthread_t));
+    WorkerArg *args = calloc(s->threads, sizeof(WorkerArg));
+    if (!s->queues || !tids || !args) { perror("calloc"); exit(1); }
+    for (int i = 0; i < s->threads; i++) {
+        pthread_mutex_init(&s->queues[i].lock, NULL);
+        s->queues[i].cap = s->task_count; // A task is in at most one queue
+        s->queues[i].items = malloc(s->task_count * sizeof(int));
+        if (!s->queues[i].items) { perror("malloc"); exit(1); }
+    }
+
+    // Deal the tasks out round-robin
+    for (int i = 0; i < s->task_count; i++) rq_push(&s->queues[i % s->threads], i);
+    s->runnable = s->task_count;
+
+    for (int i = 0; i < s->threads; i++) {
+        args[i] = (WorkerArg){ s, i };
+        if (pthread_create(&tids[i], NULL, worker, &args[i]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < s->threads; i++) pthread_join(tids[i], NULL);
+
+    for (int i = 0; i < s->threads; i++) {
+        pthread_mutex_destroy(&s->queues[i].lock);
+        free(s->queues[i].items);
+    }
+    free(s->queues);
+    s->queues = NULL;
+    free(tids);
+    free(args);
+    return s->failed;
+}
+
+VM *sched_task_vm(Scheduler *s, int task) {
+    return task >= 0 && task < s->task_count ? s->tasks[task]->vm : NULL;
+}
+
+void sched_destroy(Scheduler *s) {
+    if (!s) return;
+    for (int i = 0; i < s->task_count; i++) {
+        vm_destroy(s->tasks[i]->vm);
+        free(s->tasks[i]->inputs);
+        free(s->tasks[i]->io.out);
+        free(s->tasks[i]);
+    }
+    free(s->tasks);
+    free(s->pending);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->wake);
+    pthread_cond_destroy(&s->hungry);
+    free(s);
+}
@@ -0,0 +1,40 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "vm.h"
+
+// Green-thread scheduler (part of libvm.a)
+// Runs many VMs on a fixed pool of OS threads. Each task runs for `quantum`
+// instructions at a time (vm_run's budget) and then goes to the back of its
+// worker's run queue; an idle worker steals from the back of another
+// worker's queue. INPUT and PRINT never block an OS thread:
+//   - PRINT appends to the task's output, handed to `output` after every slice
+//   - INPUT with no data parks the task (VM_BLOCKED) until sched_feed() supplies
+//     a value; values go to parked tasks in the order they blocked
+// After sched_close_input(), INPUT with no data fails with "Input Exhausted".
+
+typedef struct Scheduler Scheduler;
+
+// Called from worker threads, one call per slice with output, never
+// concurrently for the same task
+typedef void (*SchedOutputFn)(void *ctx, int task, const char *data, size_t len);
+
+Scheduler *sched_create(int threads, long long quantum, SchedOutputFn output, void *ctx);
+// Takes ownership of `vm` (loaded, optionally verified). Returns the task id
+// (0, 1, ...) or -1, in which case the caller still owns `vm`. Only before sched_run.
+int sched_spawn(Scheduler *s, VM *vm);
+// Thread-safe; may be called while sched_run is running
+void sched_feed(Scheduler *s, int32_t value);
+// Blocks until a task is parked in INPUT (returns 1) or every task has
+// finished (returns 0), so a feeder reads its source only on demand
+int sched_wait_input(Scheduler *s);
+void sched_close_input(Scheduler *s);
+// Runs every task to completion. Returns the number of tasks that failed.
+int sched_run(Scheduler *s);
+// After sched_run: the finished VM of a task (still owned by the scheduler)
+VM *sched_task_vm(Scheduler *s, int task);
+void sched_destroy(Scheduler *s);
+
+#endif
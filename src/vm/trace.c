@@ -0,0 +1,126 @@
+#include "trace.h"
+#include "opcodes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+int trace_init(TraceBuffer *t, uint32_t entries, const char *bin_filename) {
+    // Round capacity up to a power of two so the ring index is a simple mask
+    uint32_t cap = 1;
+    while (cap < entries) cap <<= 1;
+
+    t->entries = calloc(cap, sizeof(TraceEntry));
+    if (!t->entries) return -1;
+    t->mask = cap - 1;
+    t->head = 0;
+    t->count = 0;
+
+    t->path = trace_path_for(bin_filename);
+    if (!t->path) {
+        free(t->entries);
+        t->entries = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// "prog.bin" -> "prog.trace" (caller frees)
+char *trace_path_for(const char *bin_filename) {
+    size_t len = strlen(bin_filename);
+    const char *dot = strrchr(bin_filename, '.');
+    const char *slash = strrchr(bin_filename, '/');
+    if (dot && (!slash || dot > slash)) len = dot - bin_filename;
+
+    char *path = malloc(len + sizeof(".trace"));
+    if (!path) return NULL;
+    memcpy(path, bin_filename, len);
+    strcpy(path + len, ".trace");
+    return path;
+}
+
+void trace_free(TraceBuffer *t) {
+    free(t->entries);
+    free(t->path);
+    t->entries = NULL;
+    t->path = NULL;
+}
+
+int trace_dump(const TraceBuffer *t) {
+    if (!t->entries || !t->path) return -1;
+
+    uint32_t cap = t->mask + 1;
+    uint32_t stored = (t->count < cap) ? (uint32_t)t->count : cap;
+
+    TraceFileHeader hdr;
+    memcpy(hdr.magic, TRACE_MAGIC, 4);
+    hdr.version = TRACE_VERSION;
+    hdr.entries = stored;
+    hdr.reserved = 0;
+    hdr.total = t->count;
+
+    int fd = open(t->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+
+    int ok = write(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr);
+    if (stored < cap) {
+        // Ring never wrapped: [0, stored) is already in order
+        size_t n = stored * sizeof(TraceEntry);
+        ok = ok && write(fd, t->entries, n) == (ssize_t)n;
+    } else {
+        // Oldest entries first: [head, cap) then [0, head)
+        size_t tail = (cap - t->head) * sizeof(TraceEntry);
+        size_t wrap = t->head * sizeof(TraceEntry);
+        ok = ok && write(fd, &t->entries[t->head], tail) == (ssize_t)tail;
+        ok = ok && write(fd, t->entries, wrap) == (ssize_t)wrap;
+    }
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+const char *opcode_name(uint8_t opcode) {
+    switch (opcode) {
+        case PUSH:  return "PUSH";
+        case POP:   return "POP";
+        case DUP:   return "DUP";
+        case HALT:  return "HALT";
+        case ADD:   return "ADD";
+        case SUB:   return "SUB";
+        case MUL:   return "MUL";
+        case DIV:   return "DIV";
+        case CMP:   return "CMP";
+        case EQ:    return "EQ";
+        case NE:    return "NE";
+        case LE:    return "LE";
+        case GT:    return "GT";
+        case GE:    return "GE";
+        case JMP:   return "JMP";
+        case JZ:    return "JZ";
+        case JNZ:   return "JNZ";
+        case JEQ:   return "JEQ";
+        case JNE:   return "JNE";
+        case JLT:   return "JLT";
+        case JLE:   return "JLE";
+        case JGT:   return "JGT";
+        case JGE:   return "JGE";
+        case STORE: return "STORE";
+        case LOAD:  return "LOAD";
+        case CALL:  return "CALL";
+        case RET:   return "RET";
+        case LOAD_LOCAL:  return "LOAD_LOCAL";
+        case STORE_LOCAL: return "STORE_LOCAL";
+        case LOADI: return "LOADI";
+        case STOREI: return "STOREI";
+        case ENTER: return "ENTER";
+        case LEAVE: return "LEAVE";
+        case TAILCALL: return "TAILCALL";
+        case PRINT: return "PRINT";
+        case INPUT: return "INPUT";
+        case ALLOC: return "ALLOC";
+        case MEMCPY: return "MEMCPY";
+        case MEMSET: return "MEMSET";
+        case MEMCMP: return "MEMCMP";
+        default:    return "???";
+    }
+}
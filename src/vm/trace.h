@@ -0,0 +1,62 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Execution Trace Recorder
+// Keeps the last N executed instructions in a fixed-size ring buffer so that a
+// "Runtime Error" exit can be analysed after the fact. The buffer is written to
+// <program>.trace as raw binary and decoded later with `vm <prog.bin> --show-trace`.
+
+#define TRACE_DEFAULT_ENTRIES 1024
+#define TRACE_MAGIC "VMTR"
+#define TRACE_VERSION 1
+
+// One executed instruction (12 bytes, stored on disk exactly like this)
+typedef struct {
+    int32_t pc;       // Address of the instruction
+    int32_t tos;      // Top of stack BEFORE the instruction ran (0 if empty)
+    uint8_t opcode;
+    uint8_t reserved;
+    int16_t sp;       // Stack pointer BEFORE the instruction ran (-1 = empty)
+} TraceEntry;
+
+// File header, followed by `entries` TraceEntry records (oldest first)
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t entries;     // Records stored in this file
+    uint32_t reserved;
+    uint64_t total;       // Instructions executed while tracing
+} TraceFileHeader;
+
+typedef struct {
+    TraceEntry *entries;  // NULL when tracing is disabled
+    uint32_t mask;        // Capacity - 1 (capacity is a power of two)
+    uint32_t head;        // Next slot to overwrite
+    uint64_t count;       // Total instructions recorded
+    char *path;           // Output file, computed up front so signal handlers can use it
+} TraceBuffer;
+
+int trace_init(TraceBuffer *t, uint32_t entries, const char *bin_filename);
+void trace_free(TraceBuffer *t);
+char *trace_path_for(const char *bin_filename);
+
+// Writes the ring buffer to t->path. Only uses open/write/close, so it is
+// safe to call from a signal handler.
+int trace_dump(const TraceBuffer *t);
+
+const char *opcode_name(uint8_t opcode);
+
+// Hot path: called once per dispatched instruction when tracing is enabled
+static inline void trace_record(TraceBuffer *t, int32_t pc, uint8_t opcode, int sp, int32_t tos) {
+    TraceEntry *e = &t->entries[t->head];
+    e->pc = pc;
+    e->tos = tos;
+    e->opcode = opcode;
+    e->sp = (int16_t)sp;
+    t->head = (t->head + 1) & t->mask;
+    t->count++;
+}
+
+#endif
@@ -0,0 +1,247 @@
+#include "verify.h"
+#include "opcodes.h"
+#include <stdlib.h>
+#include <limits.h>
+
+// Stack effect of each opcode. Returns 0 for opcodes the verifier cannot model.
+static int stack_effect(uint8_t op, int *pops, int *pushes, int *has_arg) {
+    *has_arg = 0;
+    switch (op) {
+        case PUSH:  *pops = 0; *pushes = 1; *has_arg = 1; return 1;
+        case POP:   *pops = 1; *pushes = 0; return 1;
+        case DUP:   *pops = 1; *pushes = 2; return 1;
+        case HALT:  *pops = 0; *pushes = 0; return 1;
+        case ADD: case SUB: case MUL: case DIV: case CMP:
+        case EQ: case NE: case LE: case GT: case GE:
+                    *pops = 2; *pushes = 1; return 1;
+        case JMP:   *pops = 0; *pushes = 0; *has_arg = 1; return 1;
+        case JZ: case JNZ:
+                    *pops = 1; *pushes = 0; *has_arg = 1; return 1;
+        case JEQ: case JNE: case JLT: case JLE: case JGT: case JGE:
+                    *pops = 2; *pushes = 0; *has_arg = 1; return 1;
+        case STORE: *pops = 1; *pushes = 0; *has_arg = 1; return 1;
+        case LOAD:  *pops = 0; *pushes = 1; *has_arg = 1; return 1;
+        case LOADI: *pops = 1; *pushes = 1; *has_arg = 1; return 1; // Address checked at runtime
+        case STOREI: *pops = 2; *pushes = 0; *has_arg = 1; return 1;
+        case PRINT: *pops = 1; *pushes = 0; return 1;
+        case INPUT: *pops = 0; *pushes = 1; return 1;
+        case ALLOC: *pops = 1; *pushes = 1; return 1;
+        case MEMCPY: case MEMSET:
+                    *pops = 3; *pushes = 0; return 1; // Ranges are checked at runtime
+        case MEMCMP: *pops = 3; *pushes = 1; return 1;
+        // Calls and frames: the effect of CALL/TAILCALL is the callee's, applied in verify_bytecode
+        case CALL: case TAILCALL: case ENTER:
+                    *pops = 0; *pushes = 0; *has_arg = 1; return 1;
+        case RET: case LEAVE:
+                    *pops = 0; *pushes = 0; return 1;
+        case LOAD_LOCAL:  *pops = 0; *pushes = 1; *has_arg = 1; return 1;
+        case STORE_LOCAL: *pops = 1; *pushes = 0; *has_arg = 1; return 1;
+        default:    return 0;
+    }
+}
+
+// Records the first failure; callers then jump to cleanup
+#define FAIL(at, msg) do { info->error_pc = (at); info->error = (msg); goto done; } while (0)
+
+// kind[pc]
+#define NOT_INSN  0 // Inside an operand
+#define UNREACHED 1
+#define REACHED   2
+
+#define UNKNOWN INT_MIN // ret[] of a function no RET has been reached in yet
+
+// Every call target is a function, analyzed on its own: depths inside it are
+// relative to the operand stack at its entry (negative once it pops its
+// arguments) and it starts with no frame open. Its summary is the depth at its
+// RETs, so a CALL continues at depth + ret[callee]. A call site whose callee has
+// no summary yet waits, and is queued again when the callee's first RET is
+// reached, so recursive functions resolve through their base case. Code after
+// a call to a function that never returns stays unreached, like code after HALT.
+int verify_bytecode(const uint8_t *code, int length, int stack_size, int addr_limit, int frame_limit, VerifyInfo *info) {
+    info->ok = 0;
+    info->max_depth = 0;
+    info->call_headroom = 0;
+    info->error_pc = -1;
+    info->error = NULL;
+
+    // Per instruction: state, depth on entry, open frame size (-1 = none), function (entry pc)
+    uint8_t *kind = NULL, *queued = NULL;
+    int *depth = NULL, *frame = NULL, *func = NULL, *worklist = NULL;
+    // Per function entry: depth after RET, words taken from below its entry, deepest point
+    int *ret = NULL, *needs = NULL, *peak = NULL;
+    if (length <= 0) FAIL(0, "Empty program");
+    kind = calloc(length, 1);
+    queued = calloc(length, 1);
+    depth = malloc(length * sizeof(int));
+    frame = malloc(length * sizeof(int));
+    func = malloc(length * sizeof(int));
+    worklist = malloc(length * sizeof(int));
+    ret = malloc(length * sizeof(int));
+    needs = calloc(length, sizeof(int));
+    peak = calloc(length, sizeof(int));
+    if (!kind || !queued || !depth || !frame || !func || !worklist || !ret || !needs || !peak) FAIL(0, "Out of memory");
+
+    // Pass 1: decode linearly to find instruction boundaries
+    for (int pc = 0; pc < length; ) {
+        int pops, pushes, has_arg;
+        uint8_t op = code[pc];
+        if (!stack_effect(op, &pops, &pushes, &has_arg)) FAIL(pc, "Unknown opcode");
+        if (has_arg && pc + 5 > length) FAIL(pc, "Truncated operand");
+        kind[pc] = UNREACHED;
+        ret[pc] = UNKNOWN;
+        pc += has_arg ? 5 : 1;
+    }
+
+#define ENQUEUE(p) do { if (!queued[p]) { queued[p] = 1; worklist[top++] = (p); } } while (0)
+#define NEED(f, n) do { if ((n) > needs[f]) needs[f] = (n); } while (0)
+
+    // Pass 2: propagate stack depths and frame states along all control flow edges
+    int top = 0;
+    kind[0] = REACHED;
+    depth[0] = 0;
+    frame[0] = -1;
+    func[0] = 0;
+    ENQUEUE(0);
+
+    while (top > 0) {
+        int pc = worklist[--top];
+        queued[pc] = 0;
+        int d = depth[pc], fr = frame[pc], f = func[pc];
+        uint8_t op = code[pc];
+        int pops, pushes, has_arg;
+        stack_effect(op, &pops, &pushes, &has_arg);
+        int32_t arg = has_arg ? *(const int32_t *)&code[pc + 1] : 0;
+
+        // The main program starts on an empty stack; a function may pop what its caller pushed
+        if (d < pops && (f == 0 || pops - d > stack_size)) FAIL(pc, "Stack underflow");
+        NEED(f, pops - d);
+        int out = d - pops + pushes;
+
+        if ((op == LOAD || op == STORE) && (arg < 0 || arg >= addr_limit)) FAIL(pc, "Memory address out of bounds");
+
+        // Frames: ENTER/LEAVE pair up within a function, locals only exist in between
+        int out_frame = fr;
+        switch (op) {
+            case ENTER:
+                if (fr >= 0) FAIL(pc, "ENTER while a frame is open");
+                if (arg < 0 || arg > frame_limit - 1) FAIL(pc, "Frame size out of range");
+                out_frame = arg;
+                break;
+            case LEAVE:
+                if (fr < 0) FAIL(pc, "LEAVE without ENTER");
+                out_frame = -1;
+                break;
+            case LOAD_LOCAL:
+            case STORE_LOCAL:
+                if (arg < 0 || arg >= fr) FAIL(pc, "Local index outside the frame");
+                break;
+            case RET:
+                if (fr >= 0) FAIL(pc, "RET with an open frame (missing LEAVE)");
+                break;
+            case TAILCALL:
+                if (fr < 0) FAIL(pc, "TAILCALL without a frame");
+                break;
+        }
+
+        // The depth this function returns at: from a RET, or the callee's for a TAILCALL.
+        // RET in the main program has no caller and fails at runtime.
+        int returns = UNKNOWN;
+        if (op == RET && f != 0) returns = d;
+
+        if (op == CALL || op == TAILCALL) {
+            if (arg <= 0 || arg >= length || kind[arg] == NOT_INSN) FAIL(pc, "Call target is not an instruction boundary");
+            if (kind[arg] == UNREACHED) {
+                kind[arg] = REACHED;
+                depth[arg] = 0;
+                frame[arg] = -1;
+                func[arg] = arg;
+                ENQUEUE(arg);
+            } else if (func[arg] != arg) FAIL(pc, "Call target is inside another function");
+            if (ret[arg] == UNKNOWN) continue; // Resumed once the callee returns
+            out = d + ret[arg];
+            if (op == TAILCALL) {
+                if (f != 0) returns = out;
+                out = UNKNOWN;
+            } else {
+                if (out < 0 && f == 0) FAIL(pc, "Stack underflow");
+                NEED(f, -out);
+            }
+        }
+
+        if (returns != UNKNOWN) {
+            if (ret[f] == UNKNOWN) {
+                ret[f] = returns;
+                // Wake the call sites waiting for this function
+                for (int p = 0; p < length; p++) {
+                    if (kind[p] == REACHED && (code[p] == CALL || code[p] == TAILCALL) &&
+                        *(const int32_t *)&code[p + 1] == f) ENQUEUE(p);
+                }
+            } else if (ret[f] != returns) FAIL(pc, "Inconsistent stack depth at return");
+        }
+        if (op == RET || op == TAILCALL) continue;
+
+        if (out > stack_size) FAIL(pc, "Stack overflow");
+        if (out > peak[f]) peak[f] = out;
+
+        // Successors: branch target and/or fall-through
+        int succ[2];
+        int nsucc = 0;
+        if (op == JMP || op == JZ || op == JNZ || (op >= JEQ && op <= JGE)) {
+            if (arg < 0 || arg >= length || kind[arg] == NOT_INSN) FAIL(pc, "Jump target is not an instruction boundary");
+            succ[nsucc++] = arg;
+        }
+        if (op != JMP && op != HALT) {
+            int next = pc + (has_arg ? 5 : 1);
+            if (next >= length) FAIL(pc, "Execution can run past the end of the code");
+            succ[nsucc++] = next;
+        }
+
+        for (int i = 0; i < nsucc; i++) {
+            int s = succ[i];
+            if (kind[s] == UNREACHED) {
+                kind[s] = REACHED;
+                depth[s] = out;
+                frame[s] = out_frame;
+                func[s] = f;
+                ENQUEUE(s);
+            } else if (func[s] != f) FAIL(s, "Control flow enters another function");
+            else if (depth[s] != out) FAIL(s, "Inconsistent stack depth at merge point");
+            else if (frame[s] != out_frame) FAIL(s, "Inconsistent frame at merge point");
+        }
+    }
+
+    // A call also takes whatever its callee takes from below the callee's entry
+    for (int changed = 1; changed; ) {
+        changed = 0;
+        for (int pc = 0; pc < length; pc++) {
+            if (kind[pc] != REACHED || (code[pc] != CALL && code[pc] != TAILCALL)) continue;
+            int f = func[pc];
+            int n = needs[*(const int32_t *)&code[pc + 1]] - depth[pc];
+            if (n <= needs[f]) continue;
+            if (f == 0) FAIL(pc, "Stack underflow in the called function");
+            if (n > stack_size) FAIL(pc, "Unbounded stack use below a call");
+            needs[f] = n;
+            changed = 1;
+        }
+    }
+
+    // Recursion makes the absolute depth of a function unknown here, so the
+    // verified interpreter checks this much headroom at every CALL/TAILCALL
+    info->max_depth = peak[0];
+    for (int pc = 1; pc < length; pc++) {
+        if (kind[pc] == REACHED && func[pc] == pc && peak[pc] > info->call_headroom) info->call_headroom = peak[pc];
+    }
+    info->ok = 1;
+
+done:
+    free(kind);
+    free(queued);
+    free(depth);
+    free(frame);
+    free(func);
+    free(worklist);
+    free(ret);
+    free(needs);
+    free(peak);
+    return info->ok;
+}
@@ -0,0 +1,34 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stdint.h>
+
+// Load-time Bytecode Verifier
+// Abstract interpretation over operand stack depth and open frames. Each CALL
+// target is checked as a function of its own. Bytecode that passes is
+// guaranteed to:
+//   - only contain known opcodes with complete operands,
+//   - only jump and call to instruction boundaries inside the code,
+//   - never underflow the operand stack, and never overflow it in the main
+//     program or within one function call,
+//   - only LOAD/STORE constant addresses inside memory + heap,
+//   - pair ENTER/LEAVE within each function, RET/TAILCALL only with its
+//     frame closed/open, and use locals only below the enclosing ENTER size,
+//   - never run past the end of the code.
+// Such code can run on the unchecked interpreter (see vm_run), which still
+// checks call_headroom at each call, because recursion depth is only known at
+// runtime, as are the frame and return stacks.
+
+typedef struct {
+    int ok;              // 1 if verification passed
+    int max_depth;       // Deepest operand stack seen on any path of the main program
+    int call_headroom;   // Most any function pushes above the stack at its entry
+    int error_pc;        // Offending instruction when !ok
+    const char *error;   // Reason when !ok
+} VerifyInfo;
+
+// stack_size: operand stack capacity; addr_limit: LOAD/STORE addresses must be
+// in [0, addr_limit); frame_limit: ENTER sizes must be below it
+int verify_bytecode(const uint8_t *code, int length, int stack_size, int addr_limit, int frame_limit, VerifyInfo *info);
+
+#endif
@@ -2,77 +2,28 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <signal.h>
+#include <limits.h>
 #include <unistd.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include "vm.h"
 #include "opcodes.h"
+#include "bytecode.h"
 #include "jit.h"
+#include "trace.h"
+#include "verify.h"
+#include "input.h"
 #include <time.h>
 
 #define STACK_SIZE 256
 #define MEM_SIZE 1024
 #define HEAP_SIZE 65536
-
-/* DEBUG METADATA */
-typedef struct {
-    int address;
-    int line_num;
-} DebugEntry;
-
-DebugEntry *debug_table = NULL;
-int debug_table_size = 0;
-
-void load_debug_info(const char *bin_filename) {
-    char dbg_filename[256];
-    strncpy(dbg_filename, bin_filename, sizeof(dbg_filename));
-    char *dot = strrchr(dbg_filename, '.');
-    if (dot) strcpy(dot, ".dbg");
-    else strcat(dbg_filename, ".dbg");
-
-    FILE *f = fopen(dbg_filename, "r");
-    if (!f) return; // No debug info
-
-    // First pass: count lines
-    int count = 0;
-    char line[128];
-    while (fgets(line, sizeof(line), f)) count++;
-    rewind(f);
-
-    debug_table = malloc(count * sizeof(DebugEntry));
-    debug_table_size = count;
-    
-    int i = 0;
-    while (fgets(line, sizeof(line), f)) {
-        int addr, ln;
-        if (sscanf(line, "%d %d", &addr, &ln) == 2) {
-            debug_table[i].address = addr;
-            debug_table[i].line_num = ln;
-            i++;
-        }
-    }
-    fclose(f);
-    printf("[VM] Loaded debug info from %s (%d entries)\n", dbg_filename, i);
-}
-
-int get_line_number(int pc) {
-    // Find entry with max address <= pc
-    int best_line = -1;
-    for (int i = 0; i < debug_table_size; i++) {
-        if (debug_table[i].address <= pc) {
-             // Because table is sorted by address (assembler writes sequentially), 
-             // we can just keep updating.
-             // Actually, assembler writes in order. 
-             // Ideally we want the EXACT address match or the associated block.
-             // But assembler.py maps "Instruction Start Address" -> "Line".
-             // If PC is inside an instruction (args), it works.
-             // Reset best_line if we find a closer one? 
-             // Since it's sorted, the 'last' one <= pc is the correct one.
-             best_line = debug_table[i].line_num;
-        } else {
-            break;
-        }
-    }
-    return best_line;
-}
+#define FRAME_STACK_SIZE 4096 // Words for call frames (ENTER/LEAVE)
+#define SPACE_SIZE (MEM_SIZE + HEAP_SIZE) // Unified address space, in words
+#define OUT_BUF_SIZE 65536    // Bytes of PRINT output held before a write()
+#define INT_TEXT_MAX 12       // "-2147483648\n"
 
 typedef struct {
     int32_t size;      // Payload size in words
@@ -80,16 +31,34 @@ typedef struct {
     uint8_t marked;    // Garbage Collection accessibility flag (0 = Unmarked, 1 = Marked)
 } ObjectHeader;
 
-typedef struct {
+struct VM {
     int32_t stack[STACK_SIZE];
     int sp;                // Data Stack Pointer
-    int32_t memory[MEM_SIZE];
-    int32_t heap[HEAP_SIZE];
+    // Addresses below MEM_SIZE are globals, the rest the heap; `space` is the
+    // same words as one array, for bulk operations and the JIT
+    union {
+        struct {
+            int32_t memory[MEM_SIZE];
+            int32_t heap[HEAP_SIZE];
+        };
+        int32_t space[SPACE_SIZE];
+    };
     int32_t free_ptr;      // Heap allocation pointer (Bump Pointer)
     int32_t allocated_list; // Linked list head of allocated objects
+    // GC: one bit per heap word, set where an object on allocated_list starts.
+    // Rebuilt before each mark phase, so only real headers are ever marked.
+    uint32_t object_map[HEAP_SIZE / 32];
     uint32_t return_stack[STACK_SIZE];
     int rsp;               // Return Stack Pointer
-    uint8_t *code;         // Bytecode array
+    // Call frames: frames[fp] holds the caller's fp, local i is frames[fp + 1 + i]
+    int32_t frames[FRAME_STACK_SIZE];
+    int fp;                // Current frame (-1 outside any function)
+    int frame_top;         // First free word above the current frame
+    const uint8_t *code;   // Bytecode array (read-only mapping of the .bin)
+    BytecodeImage *image;  // Container the code came from (debug sections, symbols)
+    int code_size;         // Bytecode length in bytes
+    int verified;          // Passed verify_bytecode(): run without runtime checks
+    int call_headroom;     // Operand stack a call may need (VerifyInfo.call_headroom)
     int pc;                // Program Counter
     int running;
     int error;             // Error flag
@@ -98,66 +67,98 @@ typedef struct {
     int stats_freed_objects;
     double stats_total_gc_time;
     int stats_max_heap_used;
+    int heap_high;         // heap[heap_high..] is still zero (raised by every write path)
 
     // DEBUGGER FIELDS
     int debug_mode;
     int step_mode;
     uint8_t breakpoints[4096]; // Simple breakpoint map
-} VM;
 
-/* GLOBAL VM POINTER FOR SIGNALS */
-VM *global_vm = NULL;
+    // EXECUTION TRACE (entries == NULL when disabled)
+    TraceBuffer trace;
+
+    VMIO *io;              // NULL: INPUT/PRINT use stdin/stdout
+    InputStream input;     // INPUT without `io`: stdin, or the --input file
+    int input_ready;       // `input` has been opened
 
-void mark(VM *vm, int32_t addr);
-void vm_gc(VM *vm);
+    // BUFFERED STDOUT: PRINT output not yet written. out_busy marks the
+    // buffer as in use by the VM itself; a vm_flush_output from a signal
+    // handler then only sets out_pending and the VM flushes when it is done.
+    char out_buf[OUT_BUF_SIZE];
+    size_t out_len;
+    volatile sig_atomic_t out_busy;
+    volatile sig_atomic_t out_pending;
 
-void handle_sigusr1(int sig) {
-    (void)sig;
-    if (global_vm) {
-        printf("\n[VM Memory Stats]\n");
-        printf("  Heap Used: %d / %d words\n", global_vm->free_ptr, HEAP_SIZE);
-        printf("  GC Runs: %d\n", global_vm->stats_gc_runs);
-        printf("  Freed Objects: %d\n", global_vm->stats_freed_objects);
-        // Calculate fragmentation or simple usage
-        int allocated_count = 0;
-        int curr = global_vm->allocated_list;
-        while(curr != -1) {
-            allocated_count++;
-            curr = global_vm->heap[curr + 1];
+    // DEBUG METADATA: points into the LINES section (loaded only on demand)
+    const LineEntry *debug_table;
+    int debug_table_size;
+
+    BytecodeImage image_store; // The mapping, if this VM loaded it (not a clone)
+    int owns_image;
+    char *path;            // .bin the code came from (trace and JIT cache files)
+    int started;           // vm_run has reset the machine for this run
+    int blocked;           // Stopped at an INPUT waiting for more io->inputs
+    long long stats_instructions;
+};
+
+/* DEBUG METADATA */
+static void load_debug_info(VM *vm) {
+    uint32_t size;
+    if (vm->debug_table) return;
+    vm->debug_table = bytecode_section(vm->image, SECTION_LINES, &size);
+    if (!vm->debug_table) return; // No debug info
+    vm->debug_table_size = size / sizeof(LineEntry);
+    printf("[VM] Loaded debug info (%d line entries, %d symbols)\n",
+           vm->debug_table_size, bytecode_symbol_count(vm->image));
+}
+
+static int get_line_number(const VM *vm, int pc) {
+    // Find entry with max address <= pc. The assembler writes the table in
+    // address order, so this is a binary search.
+    int lo = 0, hi = vm->debug_table_size - 1, best_line = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (vm->debug_table[mid].address <= pc) {
+            best_line = vm->debug_table[mid].line;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
         }
-        printf("  Live Objects: %d\n", allocated_count);
-        fsync(STDOUT_FILENO); // Ensure shell sees it
     }
+    return best_line;
 }
 
-// Forward decl
-void check_leaks(VM *vm);
+static void mark(VM *vm, int32_t addr);
 
-void handle_sigusr2(int sig) {
-    (void)sig;
-    if (global_vm) {
-        // Trigger leak check asynchronously
-        check_leaks(global_vm);
-        fsync(STDOUT_FILENO);
+// Fills object_map from allocated_list. Programs can overwrite headers with
+// STOREI, so the walk stops at a link that leaves the heap or loops back.
+static void map_objects(VM *vm) {
+    memset(vm->object_map, 0, sizeof(vm->object_map));
+    for (int32_t curr = vm->allocated_list; curr >= 0 && curr <= HEAP_SIZE - 3;
+         curr = vm->heap[curr + 1]) {
+        uint32_t bit = 1u << (curr & 31);
+        if (vm->object_map[curr >> 5] & bit) break; // Cycle
+        vm->object_map[curr >> 5] |= bit;
     }
 }
 
-
-void handle_sigurg(int sig) {
-    (void)sig;
-    if (global_vm) {
-        printf("\n[VM] Forcing Garbage Collection...\n");
-        vm_gc(global_vm);
-        printf("[VM] GC Complete. Heap: %d / %d words\n", global_vm->free_ptr, HEAP_SIZE);
-        fsync(STDOUT_FILENO);
+// Marks heap objects referenced from the locals of live frames. Walks the fp
+// chain so the saved-fp links and dead frames above frame_top are skipped.
+static void mark_frames(VM *vm) {
+    int top = vm->frame_top;
+    for (int f = vm->fp; f >= 0; top = f, f = vm->frames[f]) {
+        for (int i = f + 1; i < top; i++) {
+            int32_t val = vm->frames[i];
+            if (val >= MEM_SIZE && val < MEM_SIZE + HEAP_SIZE) {
+                int32_t header_idx = val - MEM_SIZE - 3;
+                if (header_idx >= 0) mark(vm, header_idx);
+            }
+        }
     }
 }
 
-// Reuse mark logic for LEAKS command
-// (Prototype definition to match valid C)
-void mark(VM *vm, int32_t addr);
-
-void check_leaks(VM *vm) {
+void vm_check_leaks(VM *vm) {
+    map_objects(vm);
     // 1. Clear all marks
     int curr = vm->allocated_list;
     while (curr != -1) {
@@ -183,6 +184,7 @@ void check_leaks(VM *vm) {
             if (header_idx >= 0) mark(vm, header_idx);
         }
     }
+    mark_frames(vm); // Locals of active calls
 
     // 3. Scan for UNMARKED objects
     printf("[Leaks Report]\n");
@@ -206,11 +208,11 @@ void check_leaks(VM *vm) {
     }
 }
 
-void run_debug_shell(VM *vm) {
+static void run_debug_shell(VM *vm) {
     char line[128];
     // Show current line info
-    if (debug_table) {
-        int source_line = get_line_number(vm->pc);
+    if (vm->debug_table) {
+        int source_line = get_line_number(vm, vm->pc);
         if (source_line != -1) {
             printf("[Source Line %d] ", source_line);
         }
@@ -230,11 +232,11 @@ void run_debug_shell(VM *vm) {
             return; // Run until next breakpoint
         }
         else if (strcmp(line, "registers") == 0 || strcmp(line, "r") == 0) {
-            printf("PC: %d, SP: %d, RSP: %d\n", vm->pc, vm->sp, vm->rsp);
+            printf("PC: %d, SP: %d, RSP: %d, FP: %d\n", vm->pc, vm->sp, vm->rsp, vm->fp);
             if (vm->sp >= 0) printf("Top of Stack: %d\n", vm->stack[vm->sp]);
         }
         else if (strcmp(line, "leaks") == 0) {
-            check_leaks(vm);
+            vm_check_leaks(vm);
         }
         else if (strcmp(line, "quit") == 0) {
             vm->running = 0;
@@ -243,33 +245,149 @@ void run_debug_shell(VM *vm) {
         else if (strcmp(line, "memstat") == 0) {
              printf("Heap Ptr: %d\n", vm->free_ptr);
         }
+        else if (strcmp(line, "globals") == 0) {
+            // Global variables from the SYMBOLS section
+            int count = bytecode_symbol_count(vm->image);
+            for (int i = 0; i < count; i++) {
+                const char *name;
+                const SymbolEntry *sym = bytecode_symbol(vm->image, i, &name);
+                if (sym && sym->kind == SYM_GLOBAL && sym->value >= 0 && sym->value < MEM_SIZE) {
+                    printf("  %.*s [%d] = %d\n", (int)sym->name_len, name, sym->value, vm->memory[sym->value]);
+                }
+            }
+        }
         else if (strncmp(line, "break ", 6) == 0) {
+            // break <addr> or break <function/label name>
             int addr = atoi(line + 6);
+            if (!isdigit((unsigned char)line[6])) {
+                const SymbolEntry *sym = bytecode_find_symbol(vm->image, line + 6);
+                addr = (sym && sym->kind != SYM_GLOBAL) ? sym->value : -1;
+                if (addr == -1) printf("Unknown symbol '%s'\n", line + 6);
+            }
             if (addr >= 0 && addr < 4096) {
                 vm->breakpoints[addr] = 1;
                 printf("Breakpoint set at %d\n", addr);
             }
         }
         else {
-            printf("Commands: step, continue, registers, memstat, leaks, break <addr>, quit\n");
+            printf("Commands: step, continue, registers, globals, memstat, leaks, break <addr|name>, quit\n");
+        }
+    }
+}
+
+/* OUTPUT */
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Formats `v` and a newline so that the text ends at `end`. Returns its start.
+static char *format_int(char *end, int32_t v) {
+    uint32_t u = v < 0 ? 0u - (uint32_t)v : (uint32_t)v;
+    *--end = '\n';
+    while (u >= 100) {
+        uint32_t r = (u % 100) * 2;
+        u /= 100;
+        end -= 2;
+        memcpy(end, digit_pairs + r, 2);
+    }
+    if (u >= 10) {
+        end -= 2;
+        memcpy(end, digit_pairs + u * 2, 2);
+    } else {
+        *--end = (char)('0' + u);
+    }
+    if (v < 0) *--end = '-';
+    return end;
+}
+
+// write() the whole buffer (async-signal-safe)
+static void out_write(VM *vm) {
+    size_t off = 0;
+    while (off < vm->out_len) {
+        ssize_t n = write(STDOUT_FILENO, vm->out_buf + off, vm->out_len - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break; // Output is gone (closed pipe): drop it like stdio would
         }
+        off += n;
+    }
+    vm->out_len = 0;
+}
+
+static void out_begin(VM *vm) {
+    vm->out_busy = 1;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+static void out_end(VM *vm) {
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    vm->out_busy = 0;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    if (vm->out_pending) {
+        vm->out_pending = 0;
+        out_write(vm);
+    }
+}
+
+// Flush from the VM's own thread: stdio text printed earlier goes first
+static void out_flush(VM *vm) {
+    if (vm->out_len == 0) return;
+    out_begin(vm);
+    fflush(stdout);
+    out_write(vm);
+    out_end(vm);
+}
+
+void vm_flush_output(VM *vm) {
+    if (vm->out_busy) vm->out_pending = 1;
+    else if (vm->out_len) out_write(vm);
+}
+
+static void io_append(VMIO *io, const char *data, size_t n) {
+    if (io->out_len + n > io->out_cap) {
+        size_t cap = io->out_cap ? io->out_cap * 2 : 64;
+        while (cap < io->out_len + n) cap *= 2;
+        char *out = realloc(io->out, cap);
+        if (!out) { perror("realloc"); exit(1); }
+        io->out = out;
+        io->out_cap = cap;
     }
+    memcpy(io->out + io->out_len, data, n);
+    io->out_len += n;
+}
+
+static void io_printf(VMIO *io, const char *fmt, ...) {
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    io_append(io, buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
 }
 
 // Helper to handle runtime errors safely
-void error(VM *vm, const char *msg) {
-    fprintf(stderr, "Runtime Error: %s\n", msg);
+static void error(VM *vm, const char *msg) {
+    if (vm->io) {
+        io_printf(vm->io, "Runtime Error: %s\n", msg); // Keep it with the record's output
+    } else {
+        out_flush(vm); // After the values printed before the error
+        fprintf(stderr, "Runtime Error: %s\n", msg);
+    }
     vm->running = 0;
     vm->error = 1;
 }
 
 
 
-void mark(VM *vm, int32_t addr) {
+static void mark(VM *vm, int32_t addr) {
     if (addr < 0 || addr >= HEAP_SIZE) return; // Invalid address
     
-    // Address Validation: ensure we are within heap bounds.
+    // Address Validation: a value that merely looks like a heap address (an
+    // integer, or a pointer into the middle of an object) is not a reference
     int32_t obj_idx = addr; 
+    if (!(vm->object_map[obj_idx >> 5] & (1u << (obj_idx & 31)))) return;
     
     // Check mark bit in object header (offset +2 from base address).
     if (vm->heap[obj_idx + 2]) return; 
@@ -279,6 +397,8 @@ void mark(VM *vm, int32_t addr) {
     // Recursive Marking (Transitive Reachability)
     int32_t size = vm->heap[obj_idx]; // Header[0] is size
     int32_t payload_idx = obj_idx + 3; // Skip 3-word header
+    if (size < 0) size = 0; // A header overwritten by the program
+    if (size > HEAP_SIZE - payload_idx) size = HEAP_SIZE - payload_idx;
     
     for (int i = 0; i < size; i++) {
         int32_t val = vm->heap[payload_idx + i];
@@ -293,11 +413,17 @@ void mark(VM *vm, int32_t addr) {
     }
 }
 
-void sweep(VM *vm) {
+static void sweep(VM *vm) {
     int32_t *curr_ptr = &vm->allocated_list; // Pointer to the 'next' field of previous node (or head)
     int32_t curr = vm->allocated_list;
 
     while (curr != -1) {
+        // A link map_objects() stopped at (overwritten by the program) ends the list
+        if (curr < 0 || curr >= HEAP_SIZE || !(vm->object_map[curr >> 5] & (1u << (curr & 31)))) {
+            *curr_ptr = -1;
+            break;
+        }
+        vm->object_map[curr >> 5] &= ~(1u << (curr & 31)); // Visited
         // curr is index of Header[0] (Size)
         // Header[2] is Mark
         int marked = vm->heap[curr + 2];
@@ -322,9 +448,10 @@ void sweep(VM *vm) {
     }
 }
 
-void vm_gc(VM *vm) {
+static void vm_gc(VM *vm) {
     clock_t start = clock();
     vm->stats_gc_runs++;
+    map_objects(vm);
     // 1. Mark Phase: Scan Stack
     for (int i = 0; i <= vm->sp; i++) {
         int32_t val = vm->stack[i];
@@ -348,6 +475,9 @@ void vm_gc(VM *vm) {
         }
     }
 
+    // Scan the locals of live frames
+    mark_frames(vm);
+
     // 2. Sweep Phase
     sweep(vm);
     
@@ -355,78 +485,80 @@ void vm_gc(VM *vm) {
     vm->stats_total_gc_time += (double)(end - start) / CLOCKS_PER_SEC;
 }
 
-void push(VM *vm, int32_t val) {
-    if (vm->sp >= STACK_SIZE - 1) {
+// Interpreter helpers take a `checked` flag that is a compile-time constant at
+// every call site: the verified interpreter is the same code with the bounds
+// tests folded away.
+#define VM_INLINE static inline __attribute__((always_inline))
+
+// [addr, addr + n) lies inside the address space (n == 0 is always fine)
+VM_INLINE int space_range(int32_t addr, int32_t n) {
+    return n >= 0 && addr >= 0 && addr <= SPACE_SIZE - n;
+}
+
+// Records a write to space[addr, addr + n) for vm_restart (range already checked)
+VM_INLINE void touch_space(VM *vm, int32_t addr, int32_t n) {
+    if (addr + n > MEM_SIZE + vm->heap_high) vm->heap_high = addr + n - MEM_SIZE;
+}
+
+VM_INLINE void push(VM *vm, int32_t val, const int checked) {
+    if (checked && vm->sp >= STACK_SIZE - 1) {
         error(vm, "Stack Overflow");
         return;
     }
     vm->stack[++vm->sp] = val;
 }
 
-int32_t pop(VM *vm) {
-    if (vm->sp < 0) {
+VM_INLINE int32_t pop(VM *vm, const int checked) {
+    if (checked && vm->sp < 0) {
         error(vm, "Stack Underflow");
         return 0; // Return dummy value, VM will stop anyway
     }
     return vm->stack[vm->sp--];
 }
 
-void run_vm(VM *vm) {
-    vm->pc = 0;
-    vm->sp = -1;
-    vm->rsp = -1;
-    vm->running = 1;
-    vm->pc = 0;
-    vm->sp = -1;
-    vm->rsp = -1;
-    vm->running = 1;
-    vm->pc = 0;
-    vm->sp = -1;
-    vm->rsp = -1;
-    vm->running = 1;
-    vm->error = 0;
-    vm->free_ptr = 0; // Initialize heap pointer to start
-    vm->allocated_list = -1; // -1 denotes end of linked list
-    vm->stats_gc_runs = 0;
-    vm->stats_freed_objects = 0;
-    vm->stats_total_gc_time = 0.0;
-    vm->stats_max_heap_used = 0;
-    
-    global_vm = vm;
-    signal(SIGUSR1, handle_sigusr1);
-    signal(SIGUSR2, handle_sigusr2);
-    signal(SIGURG, handle_sigurg);
-
-    // We assume the code size is large enough or trusted, assuming proper loader checks.
-    // In a real VM, you'd also check bounds of vm->pc against code size.
+// The dispatch loop. Inlined twice: once with every runtime check (debug mode,
+// unverified code) and once for bytecode accepted by verify_bytecode().
+// Runs at most `budget` instructions and returns how many are left.
+VM_INLINE long long execute(VM *vm, const int checked, long long budget) {
+    while (vm->running && budget-- > 0) {
+        // Verified code provably never leaves the code area
+        if (checked && (vm->pc < 0 || vm->pc >= vm->code_size)) {
+            error(vm, "PC Out of Bounds");
+            break;
+        }
 
-    while (vm->running) {
-        // DEBUG CHECK
-        if (vm->debug_mode) {
+        // DEBUG CHECK (debug sessions always use the checked interpreter)
+        if (checked && vm->debug_mode) {
              if (vm->step_mode || vm->breakpoints[vm->pc]) {
+                 out_flush(vm);
                  printf("[DEBUG] PC: %d, Opcode: 0x%02X\n", vm->pc, vm->code[vm->pc]);
                  run_debug_shell(vm);
                  if (!vm->running) break;
              }
         }
 
+        if (vm->trace.entries) {
+            trace_record(&vm->trace, vm->pc, vm->code[vm->pc], vm->sp,
+                         vm->sp >= 0 ? vm->stack[vm->sp] : 0);
+        }
+
         uint8_t opcode = vm->code[vm->pc++];
         switch (opcode) {
         // 1.6.1 Data Movement
         case PUSH: {
             int32_t val = *(int32_t*)&vm->code[vm->pc];
-            push(vm, val);
+            push(vm, val, checked);
             vm->pc += 4;
             break;
         }
 
         case POP: {
-            pop(vm);
+            pop(vm, checked);
             break;
         }
         case DUP: {
-            if (vm->sp < 0) { error(vm, "Stack Underflow"); break; }
-            push(vm, vm->stack[vm->sp]);
+            if (checked && vm->sp < 0) { error(vm, "Stack Underflow"); break; }
+            push(vm, vm->stack[vm->sp], checked);
             break;
         }
         case HALT: {
@@ -436,38 +568,52 @@ void run_vm(VM *vm) {
 
         // 1.6.2 Arithmetic & Logical
         case ADD: {
-            int32_t b = pop(vm);
-            int32_t a = pop(vm);
-            if (vm->running) push(vm, a + b);
+            int32_t b = pop(vm, checked);
+            int32_t a = pop(vm, checked);
+            if (!checked || vm->running) push(vm, a + b, checked);
             break;
         }
         case SUB: {
-            int32_t b = pop(vm);
-            int32_t a = pop(vm);
-            if (vm->running) push(vm, a - b);
+            int32_t b = pop(vm, checked);
+            int32_t a = pop(vm, checked);
+            if (!checked || vm->running) push(vm, a - b, checked);
             break;
         }
         case MUL: {
-            int32_t b = pop(vm);
-            int32_t a = pop(vm);
-            if (vm->running) push(vm, a * b);
+            int32_t b = pop(vm, checked);
+            int32_t a = pop(vm, checked);
+            if (!checked || vm->running) push(vm, a * b, checked);
             break;
         }
         case DIV: {
-            int32_t b = pop(vm);
-            int32_t a = pop(vm);
-            if (!vm->running) break; 
-            if (b != 0) push(vm, a / b);
+            int32_t b = pop(vm, checked);
+            int32_t a = pop(vm, checked);
+            if (checked && !vm->running) break;
+            if (b != 0) push(vm, a / b, checked);
             else error(vm, "Division by Zero");
             break;
         }
         case CMP: {
-            int32_t b = pop(vm);
-            int32_t a = pop(vm);
-            if (vm->running) push(vm, (a < b) ? 1 : 0);
+            int32_t b = pop(vm, checked);
+            int32_t a = pop(vm, checked);
+            if (!checked || vm->running) push(vm, (a < b) ? 1 : 0, checked);
             break;
         }
 
+// Pops b then a and pushes the comparison result (1/0)
+#define COMPARE(expr) { \
+            int32_t b = pop(vm, checked); \
+            int32_t a = pop(vm, checked); \
+            if (!checked || vm->running) push(vm, (expr) ? 1 : 0, checked); \
+            break; \
+        }
+        case EQ: COMPARE(a == b)
+        case NE: COMPARE(a != b)
+        case LE: COMPARE(a <= b)
+        case GT: COMPARE(a > b)
+        case GE: COMPARE(a >= b)
+#undef COMPARE
+
         // 1.6.3 Control Flow
         case JMP: {
             vm->pc = *(int32_t*)&vm->code[vm->pc];
@@ -476,35 +622,53 @@ void run_vm(VM *vm) {
         case JZ: {
             int32_t addr = *(int32_t*)&vm->code[vm->pc];
             vm->pc += 4;
-            int32_t val = pop(vm);
-            if (vm->running && val == 0) vm->pc = addr;
+            int32_t val = pop(vm, checked);
+            if ((!checked || vm->running) && val == 0) vm->pc = addr;
             break;
         }
         case JNZ: {
             int32_t addr = *(int32_t*)&vm->code[vm->pc];
             vm->pc += 4;
-            int32_t val = pop(vm);
-            if (vm->running && val != 0) vm->pc = addr;
+            int32_t val = pop(vm, checked);
+            if ((!checked || vm->running) && val != 0) vm->pc = addr;
             break;
         }
 
+// Fused compare-and-branch: one dispatch instead of compare + JZ/JNZ
+#define BRANCH_IF(expr) { \
+            int32_t addr = *(int32_t*)&vm->code[vm->pc]; \
+            vm->pc += 4; \
+            int32_t b = pop(vm, checked); \
+            int32_t a = pop(vm, checked); \
+            if ((!checked || vm->running) && (expr)) vm->pc = addr; \
+            break; \
+        }
+        case JEQ: BRANCH_IF(a == b)
+        case JNE: BRANCH_IF(a != b)
+        case JLT: BRANCH_IF(a < b)
+        case JLE: BRANCH_IF(a <= b)
+        case JGT: BRANCH_IF(a > b)
+        case JGE: BRANCH_IF(a >= b)
+#undef BRANCH_IF
+
         // 1.6.4 Memory & Functions
         case STORE: {
             int32_t idx = *(int32_t*)&vm->code[vm->pc];
             vm->pc += 4;
-            int32_t val = pop(vm);
-            if (!vm->running) break;
+            int32_t val = pop(vm, checked);
+            if (checked && !vm->running) break;
             
-            if (idx < 0) {
+            if (checked && idx < 0) {
                 error(vm, "Memory Access Out of Bounds");
             } else if (idx < MEM_SIZE) {
                 vm->memory[idx] = val;
             } else {
                 int heap_idx = idx - MEM_SIZE;
-                if (heap_idx >= HEAP_SIZE) {
+                if (checked && heap_idx >= HEAP_SIZE) {
                     error(vm, "Heap Access Out of Bounds");
                 } else {
                     vm->heap[heap_idx] = val;
+                    if (heap_idx >= vm->heap_high) vm->heap_high = heap_idx + 1;
                 }
             }
             break;
@@ -513,20 +677,48 @@ void run_vm(VM *vm) {
             int32_t idx = *(int32_t*)&vm->code[vm->pc];
             vm->pc += 4;
             
-            if (idx < 0) {
+            if (checked && idx < 0) {
                 error(vm, "Memory Access Out of Bounds");
             } else if (idx < MEM_SIZE) {
-                push(vm, vm->memory[idx]);
+                push(vm, vm->memory[idx], checked);
             } else {
                 int heap_idx = idx - MEM_SIZE;
-                if (heap_idx >= HEAP_SIZE) {
+                if (checked && heap_idx >= HEAP_SIZE) {
                     error(vm, "Heap Access Out of Bounds");
                 } else {
-                    push(vm, vm->heap[heap_idx]);
+                    push(vm, vm->heap[heap_idx], checked);
                 }
             }
             break;
         }
+        // Indirect: the address is only known now, so it is always checked,
+        // once, as an unsigned index (negative addresses fail too)
+        case LOADI: {
+            int32_t off = *(int32_t*)&vm->code[vm->pc];
+            vm->pc += 4;
+            uint32_t at = (uint32_t)pop(vm, checked) + (uint32_t)off;
+            if (checked && !vm->running) break;
+            if (at >= SPACE_SIZE) {
+                error(vm, "Memory Access Out of Bounds");
+                break;
+            }
+            push(vm, vm->space[at], checked);
+            break;
+        }
+        case STOREI: {
+            int32_t off = *(int32_t*)&vm->code[vm->pc];
+            vm->pc += 4;
+            int32_t val = pop(vm, checked);
+            uint32_t at = (uint32_t)pop(vm, checked) + (uint32_t)off;
+            if (checked && !vm->running) break;
+            if (at >= SPACE_SIZE) {
+                error(vm, "Memory Access Out of Bounds");
+                break;
+            }
+            vm->space[at] = val;
+            touch_space(vm, at, 1);
+            break;
+        }
         case CALL: {
             uint32_t addr = *(uint32_t*)&vm->code[vm->pc];
             vm->pc += 4;
@@ -535,6 +727,11 @@ void run_vm(VM *vm) {
                 error(vm, "Return Stack Overflow");
                 break;
             }
+            // Verified code only knows the callee's stack use relative to its entry
+            if (!checked && vm->sp + 1 + vm->call_headroom > STACK_SIZE) {
+                error(vm, "Stack Overflow");
+                break;
+            }
             vm->return_stack[++vm->rsp] = vm->pc; 
             vm->pc = addr;
             break;
@@ -547,27 +744,142 @@ void run_vm(VM *vm) {
             vm->pc = vm->return_stack[vm->rsp--];
             break;
         }
+        case ENTER: {
+            int32_t n = *(int32_t*)&vm->code[vm->pc];
+            vm->pc += 4;
+            if (n < 0 || n > FRAME_STACK_SIZE - 1 - vm->frame_top) {
+                error(vm, "Frame Stack Overflow");
+                break;
+            }
+            vm->frames[vm->frame_top] = vm->fp; // Link to the caller's frame
+            vm->fp = vm->frame_top;
+            vm->frame_top += 1 + n;
+            memset(&vm->frames[vm->fp + 1], 0, n * sizeof(int32_t));
+            break;
+        }
+        case LEAVE: {
+            if (vm->fp < 0) {
+                error(vm, "Frame Stack Underflow");
+                break;
+            }
+            vm->frame_top = vm->fp;
+            vm->fp = vm->frames[vm->fp];
+            break;
+        }
+        case TAILCALL: {
+            // Frame of the caller is released before the jump; the return
+            // address on return_stack is left for the callee's RET
+            int32_t addr = *(int32_t*)&vm->code[vm->pc];
+            vm->pc += 4;
+            if (vm->fp < 0) {
+                error(vm, "Frame Stack Underflow");
+                break;
+            }
+            if (!checked && vm->sp + 1 + vm->call_headroom > STACK_SIZE) {
+                error(vm, "Stack Overflow");
+                break;
+            }
+            vm->frame_top = vm->fp;
+            vm->fp = vm->frames[vm->fp];
+            vm->pc = addr;
+            break;
+        }
+        case LOAD_LOCAL: {
+            int32_t i = *(int32_t*)&vm->code[vm->pc];
+            vm->pc += 4;
+            if (checked && (vm->fp < 0 || i < 0 || i >= vm->frame_top - vm->fp - 1)) {
+                error(vm, "Local Access Out of Bounds");
+                break;
+            }
+            push(vm, vm->frames[vm->fp + 1 + i], checked);
+            break;
+        }
+        case STORE_LOCAL: {
+            int32_t i = *(int32_t*)&vm->code[vm->pc];
+            vm->pc += 4;
+            int32_t val = pop(vm, checked);
+            if (checked && !vm->running) break;
+            if (checked && (vm->fp < 0 || i < 0 || i >= vm->frame_top - vm->fp - 1)) {
+                error(vm, "Local Access Out of Bounds");
+                break;
+            }
+            vm->frames[vm->fp + 1 + i] = val;
+            break;
+        }
 
         // 1.6.5 Standard Library
         case PRINT: {
-            if (vm->sp < 0) {
+            if (checked && vm->sp < 0) {
                 error(vm, "Stack Underflow");
                 break;
             }
-            printf("%d\n", vm->stack[vm->sp--]);
-            fflush(stdout);
+            char text[INT_TEXT_MAX];
+            char *start = format_int(text + INT_TEXT_MAX, vm->stack[vm->sp--]);
+            size_t n = text + INT_TEXT_MAX - start;
+            if (vm->io) {
+                io_append(vm->io, start, n);
+                break;
+            }
+            // One write() per OUT_BUF_SIZE bytes instead of per value
+            out_begin(vm);
+            memcpy(vm->out_buf + vm->out_len, start, n);
+            vm->out_len += n;
+            if (vm->out_len > OUT_BUF_SIZE - INT_TEXT_MAX) out_write(vm);
+            out_end(vm);
             break;
         }
         case INPUT: {
             int val;
-            printf("Enter number: ");
-            if (scanf("%d", &val) == 1) {
-                if (vm->sp >= STACK_SIZE - 1) {
-                    error(vm, "Stack Overflow");
+            if (vm->io) {
+                if (vm->io->input_pos >= vm->io->input_count) {
+                    if (vm->io->input_open) {
+                        // Park: vm_run returns VM_BLOCKED and re-executes this INPUT next time
+                        vm->pc--;
+                        vm->blocked = 1;
+                        vm->running = 0;
+                        break;
+                    }
+                    error(vm, "Input Exhausted");
                     break;
                 }
-                vm->stack[++vm->sp] = val;
+                push(vm, vm->io->inputs[vm->io->input_pos++], checked);
+                break;
+            }
+            if (vm->debug_mode) {
+                // The debugger reads its commands through stdio, so its
+                // program input has to come from the same FILE
+                out_flush(vm);
+                printf("Enter number: ");
+                if (scanf("%d", &val) == 1) {
+                    push(vm, val, checked);
+                } else {
+                    fprintf(stderr, "Error: Invalid input\n");
+                    vm->running = 0;
+                    vm->error = 1;
+                }
+                break;
+            }
+            if (!vm->input_ready) {
+                input_open_fd(&vm->input, STDIN_FILENO);
+                vm->input_ready = 1;
+            }
+            if (input_drained(&vm->input)) {
+                // About to wait for more input: show everything printed so far,
+                // and prompt only a person at a terminal
+                out_flush(vm);
+                if (vm->input.tty) {
+                    printf("Enter number: ");
+                    fflush(stdout);
+                }
+            }
+            int32_t in_val;
+            int got = input_next_int(&vm->input, &in_val);
+            if (got == 1) {
+                push(vm, in_val, checked);
+            } else if (got == 0) {
+                error(vm, "Input Exhausted");
             } else {
+                out_flush(vm);
                 fprintf(stderr, "Error: Invalid input\n");
                 vm->running = 0;
                 vm->error = 1;
@@ -575,8 +887,61 @@ void run_vm(VM *vm) {
             break;
         }
 
+        // Bulk memory: one range check per instruction, then a library call
+        case MEMCPY: {
+            int32_t n = pop(vm, checked);
+            int32_t src = pop(vm, checked);
+            int32_t dst = pop(vm, checked);
+            if (checked && !vm->running) break;
+            if (!space_range(src, n) || !space_range(dst, n)) {
+                error(vm, "Memory Access Out of Bounds");
+                break;
+            }
+            memmove(vm->space + dst, vm->space + src, (size_t)n * sizeof(int32_t));
+            touch_space(vm, dst, n);
+            break;
+        }
+        case MEMSET: {
+            int32_t n = pop(vm, checked);
+            int32_t val = pop(vm, checked);
+            int32_t dst = pop(vm, checked);
+            if (checked && !vm->running) break;
+            if (!space_range(dst, n)) {
+                error(vm, "Memory Access Out of Bounds");
+                break;
+            }
+            int32_t *p = vm->space + dst;
+            touch_space(vm, dst, n);
+            if (val == 0) {
+                memset(p, 0, (size_t)n * sizeof(int32_t));
+            } else {
+                for (int32_t i = 0; i < n; i++) p[i] = val; // Vectorized by the compiler
+            }
+            break;
+        }
+        case MEMCMP: {
+            int32_t n = pop(vm, checked);
+            int32_t b = pop(vm, checked);
+            int32_t a = pop(vm, checked);
+            if (checked && !vm->running) break;
+            if (!space_range(a, n) || !space_range(b, n)) {
+                error(vm, "Memory Access Out of Bounds");
+                break;
+            }
+            const int32_t *pa = vm->space + a, *pb = vm->space + b;
+            int result = 0;
+            // memcmp finds a difference fast; its sign is by bytes, so decide on the word
+            if (memcmp(pa, pb, (size_t)n * sizeof(int32_t)) != 0) {
+                int32_t i = 0;
+                while (pa[i] == pb[i]) i++;
+                result = pa[i] < pb[i] ? -1 : 1;
+            }
+            push(vm, result, checked);
+            break;
+        }
+
         case ALLOC: {
-            int32_t size = pop(vm);
+            int32_t size = pop(vm, checked);
             if (size < 0) { error(vm, "Invalid Allocation Size"); break; }
             
             // Header: 3 words [Size, Next, Marked]
@@ -600,9 +965,10 @@ void run_vm(VM *vm) {
             if (vm->free_ptr > vm->stats_max_heap_used) {
                 vm->stats_max_heap_used = vm->free_ptr;
             }
+            if (vm->free_ptr > vm->heap_high) vm->heap_high = vm->free_ptr; // Headers
             
             // Push address of payload (skip header) to stack
-            push(vm, MEM_SIZE + addr + 3);
+            push(vm, MEM_SIZE + addr + 3, checked);
             break;
         }
 
@@ -612,79 +978,317 @@ void run_vm(VM *vm) {
             vm->error = 1;
         }
     }
+    return budget;
+}
+
+static long long execute_checked(VM *vm, long long budget) { return execute(vm, 1, budget); }
+static long long execute_verified(VM *vm, long long budget) { return execute(vm, 0, budget); }
 
-    if (vm->debug_mode && !vm->error) {
-         printf("[DEBUG] Execution Finished.\n");
-         run_debug_shell(vm);
+// Resets registers, heap bookkeeping and statistics for a fresh run
+static void vm_reset(VM *vm) {
+    vm->pc = 0;
+    vm->sp = -1;
+    vm->rsp = -1;
+    vm->running = 1;
+    vm->fp = -1;
+    vm->frame_top = 0;
+    vm->error = 0;
+    vm->free_ptr = 0; // Initialize heap pointer to start
+    vm->allocated_list = -1; // -1 denotes end of linked list
+    vm->stats_gc_runs = 0;
+    vm->stats_freed_objects = 0;
+    vm->stats_total_gc_time = 0.0;
+    vm->stats_max_heap_used = 0;
+}
+
+VMStatus vm_run(VM *vm, long long budget) {
+    if (!vm->started) {
+        vm_reset(vm);
+        vm->started = 1;
     }
+    if (vm->running) {
+        long long limit = budget > 0 ? budget : LLONG_MAX;
+        long long left;
+        if (vm->verified && !vm->debug_mode) left = execute_verified(vm, limit);
+        else left = execute_checked(vm, limit);
+        vm->stats_instructions += limit - left;
+        out_flush(vm);
+        if (vm->running) return VM_YIELD;
+        if (vm->blocked) {
+            vm->blocked = 0;
+            vm->running = 1;
+            return VM_BLOCKED;
+        }
+
+        // Post-mortem: keep the last N instructions that led to the error
+        if (vm->error && vm->trace.entries) {
+            if (trace_dump(&vm->trace) == 0)
+                fprintf(stderr, "[VM] Execution trace written to %s\n", vm->trace.path);
+        }
+
+        if (vm->debug_mode && !vm->error) {
+             printf("[DEBUG] Execution Finished.\n");
+             run_debug_shell(vm);
+        }
+    }
+    return vm->error ? VM_ERROR : VM_OK;
+}
+
+void vm_restart(VM *vm) {
+    // Each run starts from a clean machine, as if it were its own process
+    memset(vm->memory, 0, sizeof(vm->memory));
+    // Every heap write raises heap_high, wherever it lands (STORE, STOREI and
+    // MEMSET/MEMCPY can write above the bump pointer)
+    memset(vm->heap, 0, vm->heap_high * sizeof(int32_t));
+    vm->heap_high = 0;
+    vm->started = 0;
+    vm->stats_instructions = 0;
+}
+
+VM *vm_create(void) {
+    VM *vm = calloc(1, sizeof(VM));
+    if (!vm) return NULL;
+    vm->fp = -1;
+    vm->sp = -1;
+    vm->allocated_list = -1; // Empty heap until the first run
+    return vm;
+}
+
+int vm_load(VM *vm, const char *path) {
+    // mmap the program read-only and validate its header (magic, version,
+    // sizes, checksum). The VM executes straight from the mapping.
+    if (vm->image) return -1; // Already loaded
+    if (bytecode_load(path, STACK_SIZE, HEAP_SIZE, &vm->image_store) != 0) return -1;
+    vm->path = strdup(path);
+    if (!vm->path) {
+        bytecode_unload(&vm->image_store);
+        return -1;
+    }
+    vm->image = &vm->image_store;
+    vm->owns_image = 1;
+    vm->code = vm->image->code;
+    vm->code_size = vm->image->code_size;
+    return 0;
+}
+
+VM *vm_clone(const VM *proto) {
+    VM *vm = vm_create();
+    if (!vm) return NULL;
+    vm->code = proto->code;
+    vm->code_size = proto->code_size;
+    vm->image = proto->image;
+    vm->verified = proto->verified;
+    vm->call_headroom = proto->call_headroom;
+    return vm;
+}
+
+void vm_destroy(VM *vm) {
+    if (!vm) return;
+    if (vm->owns_image) bytecode_unload(&vm->image_store);
+    trace_free(&vm->trace);
+    if (vm->input_ready) input_close(&vm->input);
+    free(vm->path);
+    free(vm);
+}
+
+int vm_verify(VM *vm, VerifyInfo *info) {
+    VerifyInfo local;
+    if (!info) info = &local;
+    vm->verified = verify_bytecode(vm->code, vm->code_size, STACK_SIZE, MEM_SIZE + HEAP_SIZE, FRAME_STACK_SIZE, info);
+    vm->call_headroom = info->call_headroom;
+    return vm->verified;
+}
+
+void vm_set_debug(VM *vm) {
+    vm->debug_mode = 1;
+    load_debug_info(vm); // Debug sections are only read in debug mode
+    vm->step_mode = 1; // Start paused
+}
+
+int vm_set_trace(VM *vm, int entries) {
+    trace_free(&vm->trace);
+    return trace_init(&vm->trace, entries, vm->path ? vm->path : "vm.bin");
+}
+
+void vm_set_io(VM *vm, VMIO *io) { vm->io = io; }
+
+int vm_set_input(VM *vm, const char *path) {
+    if (vm->input_ready) input_close(&vm->input);
+    vm->input_ready = input_open_file(&vm->input, path) == 0;
+    return vm->input_ready ? 0 : -1;
+}
+
+void vm_stats(const VM *vm, VMStats *out) {
+    out->instructions = vm->stats_instructions;
+    out->heap_used = vm->free_ptr;
+    out->heap_size = HEAP_SIZE;
+    out->max_heap_used = vm->stats_max_heap_used;
+    out->gc_runs = vm->stats_gc_runs;
+    out->freed_objects = vm->stats_freed_objects;
+    out->gc_time = vm->stats_total_gc_time;
+    out->live_objects = 0;
+    for (int curr = vm->allocated_list; curr != -1; curr = vm->heap[curr + 1]) out->live_objects++;
+}
+
+int vm_top(const VM *vm, int32_t *val) {
+    if (vm->sp < 0) return 0;
+    *val = vm->stack[vm->sp];
+    return 1;
+}
+
+int vm_failed(const VM *vm) { return vm->error; }
+
+void vm_collect(VM *vm) { vm_gc(vm); }
+
+int vm_dump_trace(const VM *vm) {
+    return vm->trace.entries ? trace_dump(&vm->trace) : -1;
 }
 
-#ifndef TESTING
-int main(int argc, char **argv) {
-#else
-int run_vm_main(int argc, char **argv) {
-#endif
-    if (argc < 2) return 1;
-    FILE *f = fopen(argv[1], "rb");
+// Reads the source file next to the binary ("prog.bin" -> "prog.lang") so the
+// trace decoder can show the text of each line. Returns NULL if not found.
+static char **load_source_lines(const char *bin_filename, int *count) {
+    *count = 0;
+    size_t len = strlen(bin_filename);
+    const char *dot = strrchr(bin_filename, '.');
+    if (dot) len = dot - bin_filename;
+    char *src_filename = malloc(len + sizeof(".lang"));
+    if (!src_filename) return NULL;
+    memcpy(src_filename, bin_filename, len);
+    strcpy(src_filename + len, ".lang");
+
+    FILE *f = fopen(src_filename, "r");
+    free(src_filename);
+    if (!f) return NULL;
+
+    char **lines = NULL;
+    char buf[256];
+    int cap = 0;
+    while (fgets(buf, sizeof(buf), f)) {
+        if (*count == cap) {
+            cap = cap ? cap * 2 : 64;
+            lines = realloc(lines, cap * sizeof(char *));
+        }
+        buf[strcspn(buf, "\n")] = 0;
+        lines[(*count)++] = strdup(buf);
+    }
+    fclose(f);
+    return lines;
+}
+
+// Decoder for <prog>.trace written by --trace
+int vm_show_trace(VM *vm) {
+    const char *bin_filename = vm->path;
+    char *path = trace_path_for(bin_filename);
+    FILE *f = path ? fopen(path, "rb") : NULL;
     if (!f) {
-        fprintf(stderr, "Error opening file %s\n", argv[1]);
+        fprintf(stderr, "No trace file for %s (run with --trace first)\n", bin_filename);
+        free(path);
         return 1;
     }
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    
-    uint8_t *code = malloc(size);
-    if (!code) {
+
+    TraceFileHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, TRACE_MAGIC, 4) != 0 ||
+        hdr.version != TRACE_VERSION) {
+        fprintf(stderr, "Error: %s is not a valid trace file\n", path);
         fclose(f);
-        fprintf(stderr, "Memory allocation failed\n");
+        free(path);
         return 1;
     }
-    
-    fread(code, 1, size, f);
-    fclose(f);
 
-    VM vm = { .code = code };
+    load_debug_info(vm);
+    int src_count = 0;
+    char **src_lines = load_source_lines(bin_filename, &src_count);
+
+    printf("[Trace] Last %u of %llu executed instructions (oldest first)\n",
+           hdr.entries, (unsigned long long)hdr.total);
+    uint64_t seq = hdr.total - hdr.entries;
+    TraceEntry e;
+    for (uint32_t i = 0; i < hdr.entries && fread(&e, sizeof(e), 1, f) == 1; i++) {
+        printf("  #%-10llu PC %-5d %-6s SP %-4d", (unsigned long long)++seq, e.pc,
+               opcode_name(e.opcode), e.sp);
+        if (e.sp >= 0) printf("TOS %-11d", e.tos);
+        else printf("TOS %-11s", "-");
 
-    // Check for JIT flag or Debug flag
-    int use_jit = 0;
-    // Simple arg parsing logic loop
-    for(int i=2; i<argc; i++) {
-        if (strcmp(argv[i], "--jit") == 0) use_jit = 1;
-        if (strcmp(argv[i], "--debug") == 0) vm.debug_mode = 1;
+        int line = vm->debug_table ? get_line_number(vm, e.pc) : -1;
+        if (line > 0 && line <= src_count) printf(" line %d: %s", line, src_lines[line - 1]);
+        else if (line > 0) printf(" line %d", line);
+        printf("\n");
     }
 
-    if (use_jit) {
-        printf("Running with JIT...\n");
-        jit_func jitted_code = compile(code, size);
-        if (jitted_code) {
-            // JIT returns the top of the stack as an integer
-            int result = jitted_code();
-            printf("JIT Result: %d\n", result);
-        } else {
-            fprintf(stderr, "JIT Compilation Failed\n");
-            return 1;
-        }
-    } else {
-        if (vm.debug_mode) {
-            printf("VM running in DEBUG mode. Type 'help' for commands.\n");
-            load_debug_info(argv[1]);
-            vm.step_mode = 1; // Start paused
-        }
-        run_vm(&vm);
-        
-        if (!vm.error && vm.sp >= 0)
-            printf("Top of stack: %d\n", vm.stack[vm.sp]);
-        else if (!vm.error)
-            printf("Stack empty\n");
+    for (int i = 0; i < src_count; i++) free(src_lines[i]);
+    free(src_lines);
+    fclose(f);
+    free(path);
+    return 0;
+}
 
-        if (vm.stats_gc_runs > 0) {
-            printf("[GC Stats] Runs: %d, Freed: %d, Total GC Time: %.6fs, Max Heap: %d words\n", 
-                vm.stats_gc_runs, vm.stats_freed_objects, vm.stats_total_gc_time, vm.stats_max_heap_used);
-        }
+// Cached native code from the SECTION_JIT of the container, if it was
+// compiled from exactly this CODE section by this JIT for `mem_words`
+static jit_func load_jit_cache(BytecodeImage *image, int mem_words) {
+    uint32_t size;
+    const uint8_t *data = bytecode_section(image, SECTION_JIT, &size);
+    if (!data || size < sizeof(JitCacheHeader)) return NULL;
+
+    const JitCacheHeader *jh = (const JitCacheHeader *)data;
+    if (jh->code_checksum != image->code_checksum || sizeof(JitCacheHeader) + jh->native_size > size)
+        return NULL;
+    if (jh->jit_version != JIT_VERSION || jh->mem_words != (uint32_t)mem_words) return NULL; // Stale
+    printf("[VM] Using cached JIT code (%u bytes)\n", jh->native_size);
+    return jit_load(data + sizeof(JitCacheHeader), jh->native_size);
+}
+
+// Rewrites the container with a fresh SECTION_JIT (replacing any stale one)
+static void save_jit_cache(const char *bin_filename, BytecodeImage *image, int mem_words,
+                           const void *native, size_t native_size) {
+    size_t payload_size = sizeof(JitCacheHeader) + native_size;
+    uint8_t *payload = malloc(payload_size);
+    BytecodeSection *sections = malloc((image->section_count + 1) * sizeof(BytecodeSection));
+    if (!payload || !sections) {
+        free(payload);
+        free(sections);
+        return;
     }
+    JitCacheHeader jh = { image->code_checksum, (uint32_t)native_size, JIT_VERSION, (uint32_t)mem_words };
+    memcpy(payload, &jh, sizeof(jh));
+    memcpy(payload + sizeof(jh), native, native_size);
 
-    free(code);
-    if (debug_table) free(debug_table);
-    return vm.error ? 1 : 0;
+    int count = 0;
+    for (int i = 0; i < image->section_count; i++) {
+        const SectionEntry *s = &image->sections[i];
+        if (s->type == SECTION_JIT) continue;
+        sections[count].type = s->type;
+        sections[count].data = (const uint8_t *)image->map + s->offset;
+        sections[count].size = s->size;
+        count++;
+    }
+    sections[count].type = SECTION_JIT;
+    sections[count].data = payload;
+    sections[count].size = payload_size;
+    count++;
+
+    if (bytecode_write(bin_filename, image->stack_size, image->heap_size, sections, count) == 0)
+        printf("[VM] Cached %zu bytes of JIT code in %s\n", native_size, bin_filename);
+    free(payload);
+    free(sections);
+}
+
+int vm_run_jit(VM *vm, int cache, int *result) {
+    jit_func jitted_code = load_jit_cache(vm->image, SPACE_SIZE);
+    if (!jitted_code) {
+        size_t native_size = 0;
+        jitted_code = compile(vm->code, vm->code_size, SPACE_SIZE, &native_size);
+        if (jitted_code && cache && vm->path) save_jit_cache(vm->path, vm->image, SPACE_SIZE, (void *)jitted_code, native_size);
+    }
+    JitStacks stacks;
+    if (!jitted_code) return -1;
+    if (jit_stacks_alloc(&stacks) != 0) {
+        jit_free(jitted_code);
+        return -1;
+    }
+    // JIT returns the top of the stack as an integer
+    *result = jitted_code(stacks.frames, stacks.returns, vm->space);
+    jit_stacks_free(&stacks);
+    jit_free(jitted_code);
+    vm->heap_high = HEAP_SIZE; // Native code does not track its writes
+    return 0;
 }
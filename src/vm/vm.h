@@ -0,0 +1,102 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "verify.h"
+
+// Reentrant VM library (libvm.a)
+// Every VM owns all of its state (stacks, memory, heap, debug tables, trace),
+// so any number of them can run in one process, one per thread at a time.
+// The library installs no signal handlers and keeps no globals; the CLI in
+// vm_main.c wires SIGUSR1/SIGUSR2/SIGURG to the functions below.
+//
+//   VM *vm = vm_create();
+//   if (vm_load(vm, "prog.bin") == 0) {
+//       vm_verify(vm, NULL);
+//       while (vm_run(vm, 100000) == VM_YIELD) { /* do other work */ }
+//   }
+//   vm_destroy(vm);
+
+typedef struct VM VM;
+
+typedef enum {
+    VM_OK,      // Halted (HALT or end of program)
+    VM_YIELD,   // Instruction budget used up; vm_run continues where it stopped
+    VM_ERROR,   // Runtime error, already reported
+    VM_BLOCKED  // INPUT found no data in an open VMIO; add inputs and vm_run again
+} VMStatus;
+
+// Snapshot of a VM's counters
+typedef struct {
+    long long instructions; // Executed so far (interpreter only)
+    int heap_used;          // Bump pointer, in words
+    int heap_size;
+    int max_heap_used;
+    int live_objects;
+    int gc_runs;
+    int freed_objects;
+    double gc_time;         // Seconds of CPU time spent in the GC
+} VMStats;
+
+// Redirected I/O: INPUT reads `inputs` in order and PRINT (and runtime
+// errors) append to `out` instead of using stdin/stdout/stderr.
+typedef struct {
+    const int32_t *inputs;
+    int input_count;
+    int input_pos;
+    int input_open;        // 1: more inputs may be appended, so running out blocks instead of failing
+    char *out;             // malloc'd, not NUL-terminated; the owner frees it
+    size_t out_len, out_cap;
+} VMIO;
+
+// -- Lifecycle --
+VM *vm_create(void);
+// Maps and validates a .bin container. Returns 0 on success.
+int vm_load(VM *vm, const char *path);
+// A fresh VM running the code `proto` loaded. The mapping is shared read-only
+// and must outlive the clone.
+VM *vm_clone(const VM *proto);
+void vm_destroy(VM *vm);
+
+// -- Configuration (before the first vm_run) --
+// Verifies the code; if it passes, vm_run uses the unchecked interpreter.
+// Returns 1 if verified. `info` may be NULL.
+int vm_verify(VM *vm, VerifyInfo *info);
+// Interactive debugger on stdin/stdout, starting paused at PC 0
+void vm_set_debug(VM *vm);
+// Keeps the last `entries` instructions for post-mortem analysis. Returns 0 on success.
+int vm_set_trace(VM *vm, int entries);
+void vm_set_io(VM *vm, VMIO *io);
+// INPUT reads integers from `path` (mapped with mmap) instead of stdin.
+// Returns 0 on success. Without it, stdin is read in large chunks and the
+// "Enter number: " prompt is shown only when stdin is a terminal.
+int vm_set_input(VM *vm, const char *path);
+
+// -- Execution --
+// Runs at most `budget` instructions (budget <= 0: until the program ends)
+VMStatus vm_run(VM *vm, long long budget);
+// Makes the next vm_run start over with cleared memory and heap
+void vm_restart(VM *vm);
+// Runs the program with the JIT (`cache`: also store the native code in the
+// .bin). Returns 0 and the top of the native stack in *result on success.
+int vm_run_jit(VM *vm, int cache, int *result);
+// PRINT to stdout is buffered per VM and written when the buffer fills,
+// before INPUT prompts, on errors and when vm_run returns. This writes out
+// what is buffered now; it is async-signal-safe, for flushing on a timer.
+void vm_flush_output(VM *vm);
+
+// -- Inspection --
+void vm_stats(const VM *vm, VMStats *out);
+// 1 and *val = top of the operand stack, or 0 if it is empty
+int vm_top(const VM *vm, int32_t *val);
+int vm_failed(const VM *vm);
+void vm_check_leaks(VM *vm);   // Prints a [Leaks Report]
+void vm_collect(VM *vm);       // Forces a garbage collection
+// Writes the trace buffer, if enabled. Uses only open/write/close, so it
+// can be called from a signal handler.
+int vm_dump_trace(const VM *vm);
+// Decodes <prog>.trace written by an earlier --trace run
+int vm_show_trace(VM *vm);
+
+#endif
@@ -0,0 +1,567 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include "vm.h"
+#include "sched.h"
+#include "input.h"
+#include "trace.h"
+
+// Command-line front end for libvm: argument parsing, signal handling,
+// worker mode, batch mode and scheduler mode. Everything process-wide lives here; the
+// library itself keeps no globals.
+
+/* VM SERVED BY THE SIGNAL HANDLERS */
+static VM *signal_vm = NULL;
+
+void handle_sigusr1(int sig) {
+    (void)sig;
+    if (signal_vm) {
+        VMStats st;
+        vm_stats(signal_vm, &st);
+        printf("\n[VM Memory Stats]\n");
+        printf("  Heap Used: %d / %d words\n", st.heap_used, st.heap_size);
+        printf("  GC Runs: %d\n", st.gc_runs);
+        printf("  Freed Objects: %d\n", st.freed_objects);
+        printf("  Live Objects: %d\n", st.live_objects);
+        fsync(STDOUT_FILENO); // Ensure shell sees it
+    }
+}
+
+void handle_sigusr2(int sig) {
+    (void)sig;
+    if (signal_vm) {
+        // Trigger leak check asynchronously
+        vm_check_leaks(signal_vm);
+        fsync(STDOUT_FILENO);
+    }
+}
+
+void handle_sigurg(int sig) {
+    (void)sig;
+    if (signal_vm) {
+        VMStats st;
+        printf("\n[VM] Forcing Garbage Collection...\n");
+        vm_collect(signal_vm);
+        vm_stats(signal_vm, &st);
+        printf("[VM] GC Complete. Heap: %d / %d words\n", st.heap_used, st.heap_size);
+        fsync(STDOUT_FILENO);
+    }
+}
+
+// Fatal signals: write out buffered PRINT output and save the execution
+// trace, then die with the original signal
+void handle_fatal_trace(int sig) {
+    if (signal_vm) {
+        vm_flush_output(signal_vm); // Async-signal-safe
+        vm_dump_trace(signal_vm);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// Output timer: PRINT output is buffered, so a program that prints a little
+// and then computes for a long time still shows its output within --flush-ms
+void handle_sigalrm(int sig) {
+    (void)sig;
+    if (signal_vm) vm_flush_output(signal_vm);
+}
+
+static void start_flush_timer(int ms) {
+    if (ms <= 0) return;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_sigalrm;
+    sa.sa_flags = SA_RESTART; // Don't break a pending read in INPUT
+    sigaction(SIGALRM, &sa, NULL);
+    struct itimerval it = { { ms / 1000, (ms % 1000) * 1000 }, { ms / 1000, (ms % 1000) * 1000 } };
+    setitimer(ITIMER_REAL, &it, NULL);
+}
+
+static void stop_flush_timer(void) {
+    struct itimerval it;
+    memset(&it, 0, sizeof(it));
+    setitimer(ITIMER_REAL, &it, NULL);
+}
+
+static void install_signal_handlers(VM *vm, int tracing) {
+    signal_vm = vm;
+    signal(SIGUSR1, handle_sigusr1);
+    signal(SIGUSR2, handle_sigusr2);
+    signal(SIGURG, handle_sigurg);
+    if (tracing) {
+        signal(SIGINT, handle_fatal_trace);
+        signal(SIGTERM, handle_fatal_trace);
+        signal(SIGQUIT, handle_fatal_trace);
+        signal(SIGSEGV, handle_fatal_trace);
+    }
+}
+
+/* BATCH MODE: vm prog.bin --batch inputs.txt [--threads N] */
+// Runs the program once per line of inputs.txt; the integers on a line are
+// what INPUT returns, in order. Every thread owns a VM and shares the mapped,
+// already verified code. Records are split into one contiguous range per
+// thread: the owner takes from the front of its range and an idle thread
+// steals from the back of another's. Outputs are written in input order.
+
+typedef struct {
+    int start, count;      // Slice of Batch.ints
+} BatchRecord;
+
+typedef struct {
+    pthread_mutex_t lock;
+    int next, end;         // Unclaimed records are [next, end)
+} BatchQueue;
+
+typedef struct {
+    const VM *proto;       // Loaded and verified; every thread runs a clone
+    const int32_t *ints;
+    const BatchRecord *records;
+    VMIO *results;         // One per record, filled by whichever thread ran it
+    BatchQueue *queues;
+    int thread_count;
+} Batch;
+
+typedef struct {
+    Batch *batch;
+    int id;
+    int failed, stolen;
+} BatchWorker;
+
+// Claims a record from the front (owner) or back (thief) of `q`; -1 if empty
+static int batch_take(BatchQueue *q, int steal) {
+    int r = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->next < q->end) r = steal ? --q->end : q->next++;
+    pthread_mutex_unlock(&q->lock);
+    return r;
+}
+
+static void *batch_thread(void *arg) {
+    BatchWorker *w = arg;
+    Batch *b = w->batch;
+    VM *vm = vm_clone(b->proto);
+    if (!vm) { perror("calloc"); exit(1); }
+
+    for (;;) {
+        int r = batch_take(&b->queues[w->id], 0);
+        for (int k = 1; r < 0 && k < b->thread_count; k++) {
+            r = batch_take(&b->queues[(w->id + k) % b->thread_count], 1);
+            if (r >= 0) w->stolen++;
+        }
+        if (r < 0) break;
+
+        VMIO *io = &b->results[r];
+        io->inputs = b->ints + b->records[r].start;
+        io->input_count = b->records[r].count;
+        vm_restart(vm);
+        vm_set_io(vm, io);
+        if (vm_run(vm, 0) == VM_ERROR) w->failed++;
+    }
+    vm_destroy(vm);
+    return NULL;
+}
+
+// Parses one record per non-empty line. Returns the record count, or -1.
+static int batch_load(const char *path, int32_t **ints_out, BatchRecord **records_out) {
+    InputStream in;
+    if (input_open_file(&in, path) != 0) return -1;
+    int32_t *ints = NULL;
+    BatchRecord *records = NULL;
+    int int_count = 0, int_cap = 0, count = 0, cap = 0;
+    long line = -1;
+    int32_t v;
+    int got;
+
+    // A record starts at the first integer of each line that has one
+    while ((got = input_next_int(&in, &v)) == 1) {
+        if (in.lines != line) {
+            line = in.lines;
+            if (count == cap) {
+                cap = cap ? cap * 2 : 256;
+                records = realloc(records, cap * sizeof(BatchRecord));
+                if (!records) { perror("realloc"); exit(1); }
+            }
+            records[count++] = (BatchRecord){ int_count, 0 };
+        }
+        if (int_count == int_cap) {
+            int_cap = int_cap ? int_cap * 2 : 1024;
+            ints = realloc(ints, int_cap * sizeof(int32_t));
+            if (!ints) { perror("realloc"); exit(1); }
+        }
+        ints[int_count++] = v;
+        records[count - 1].count++;
+    }
+    if (got < 0) fprintf(stderr, "[VM] %s:%ld: not an integer\n", path, in.lines + 1);
+    input_close(&in);
+    if (got < 0) {
+        free(ints);
+        free(records);
+        return -1;
+    }
+    *ints_out = ints;
+    *records_out = records;
+    return count;
+}
+
+static int run_batch(const VM *proto, const char *path, int threads) {
+    int32_t *ints = NULL;
+    BatchRecord *records = NULL;
+    int count = batch_load(path, &ints, &records);
+    if (count < 0) return 1;
+    if (threads > count) threads = count > 0 ? count : 1;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    Batch b = { proto, ints, records, calloc(count ? count : 1, sizeof(VMIO)),
+                calloc(threads, sizeof(BatchQueue)), threads };
+    BatchWorker *workers = calloc(threads, sizeof(BatchWorker));
+    pthread_t *tids = calloc(threads, sizeof(pthread_t));
+    if (!b.results || !b.queues || !workers || !tids) { perror("calloc"); exit(1); }
+
+    for (int t = 0; t < threads; t++) {
+        pthread_mutex_init(&b.queues[t].lock, NULL);
+        b.queues[t].next = (int)((long)count * t / threads);
+        b.queues[t].end = (int)((long)count * (t + 1) / threads);
+        workers[t] = (BatchWorker){ &b, t, 0, 0 };
+    }
+    for (int t = 0; t < threads; t++) {
+        if (pthread_create(&tids[t], NULL, batch_thread, &workers[t]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    int failed = 0, stolen = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+        failed += workers[t].failed;
+        stolen += workers[t].stolen;
+        pthread_mutex_destroy(&b.queues[t].lock);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    for (int r = 0; r < count; r++) {
+        if (b.results[r].out_len) fwrite(b.results[r].out, 1, b.results[r].out_len, stdout);
+        free(b.results[r].out);
+    }
+    fflush(stdout);
+    fprintf(stderr, "[VM] Batch: %d records on %d threads, %d failed, %d stolen, %.3fs\n",
+            count, threads, failed, stolen,
+            (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+
+    free(b.results);
+    free(b.queues);
+    free(workers);
+    free(tids);
+    free(ints);
+    free(records);
+    return failed ? 1 : 0;
+}
+
+/* SCHEDULER MODE: vm --sched a.bin b.bin ... [--threads N] [--quantum N] [--input FILE] [--no-verify] */
+// Runs several programs at once as green threads (sched.c) on N OS threads.
+// A reader thread feeds the integers typed on stdin to the programs waiting
+// in INPUT, oldest first; output lines are prefixed with the program's position
+// on the command line: "[0] 42".
+
+typedef struct {
+    pthread_mutex_t lock;
+    char *at_line_start;   // Per task: the next byte starts a new output line
+} SchedOutput;
+
+static void sched_output(void *ctx, int task, const char *data, size_t len) {
+    SchedOutput *so = ctx;
+    pthread_mutex_lock(&so->lock);
+    for (size_t i = 0; i < len; i++) {
+        if (so->at_line_start[task]) printf("[%d] ", task);
+        putchar(data[i]);
+        so->at_line_start[task] = data[i] == '\n';
+    }
+    fflush(stdout);
+    pthread_mutex_unlock(&so->lock);
+}
+
+typedef struct {
+    Scheduler *s;
+    InputStream in;        // stdin, or the --input file
+} SchedReader;
+
+static void *sched_reader(void *arg) {
+    SchedReader *r = arg;
+    int32_t v;
+    int got;
+    // Read only when a program is waiting for a value, so a background
+    // job that never calls input() leaves the terminal to the shell
+    while (sched_wait_input(r->s) && (got = input_next_int(&r->in, &v)) != 0) {
+        if (got < 0) fprintf(stderr, "[VM] Ignoring non-integer input\n");
+        else sched_feed(r->s, v);
+    }
+    sched_close_input(r->s);
+    return NULL;
+}
+
+static int run_sched(int argc, char **argv) {
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    long long quantum = 10000;
+    int use_verifier = 1;
+    const char *input_file = NULL;
+    const char *progs[argc];
+    int count = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--quantum") == 0 && i + 1 < argc) quantum = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) input_file = argv[++i];
+        else if (strcmp(argv[i], "--no-verify") == 0) use_verifier = 0;
+        else progs[count++] = argv[i];
+    }
+    if (count == 0) {
+        fprintf(stderr, "Usage: vm --sched <program.bin>... [--threads N] [--quantum N]\n");
+        return 1;
+    }
+
+    SchedOutput so = { PTHREAD_MUTEX_INITIALIZER, malloc(count) };
+    Scheduler *s = sched_create(threads, quantum, sched_output, &so);
+    if (!so.at_line_start || !s) { perror("malloc"); exit(1); }
+    memset(so.at_line_start, 1, count);
+
+    for (int i = 0; i < count; i++) {
+        VM *vm = vm_create();
+        if (!vm) { perror("calloc"); exit(1); }
+        if (vm_load(vm, progs[i]) != 0) {
+            vm_destroy(vm);
+            sched_destroy(s);
+            free(so.at_line_start);
+            return 1;
+        }
+        if (use_verifier) vm_verify(vm, NULL);
+        if (sched_spawn(s, vm) < 0) {
+            fprintf(stderr, "[VM] Cannot start a task for %s\n", progs[i]);
+            vm_destroy(vm);
+            sched_destroy(s);
+            free(so.at_line_start);
+            return 1;
+        }
+    }
+
+    // Detached: the reader may still be blocked in read() on stdin when every task is done
+    static SchedReader r;
+    r.s = s;
+    if (input_file) {
+        if (input_open_file(&r.in, input_file) != 0) return 1;
+    } else {
+        input_open_fd(&r.in, STDIN_FILENO);
+    }
+    pthread_t reader;
+    if (pthread_create(&reader, NULL, sched_reader, &r) != 0) {
+        perror("pthread_create");
+        exit(1);
+    }
+    pthread_detach(reader);
+
+    int failed = sched_run(s);
+    for (int i = 0; i < count; i++) {
+        int32_t top;
+        VM *vm = sched_task_vm(s, i);
+        if (vm_failed(vm)) printf("[%d] %s failed\n", i, progs[i]);
+        else if (vm_top(vm, &top)) printf("[%d] Top of stack: %d\n", i, top);
+        else printf("[%d] Stack empty\n", i);
+    }
+    fflush(stdout);
+    // Not destroyed: the reader thread may still call sched_feed
+    _exit(failed ? 1 : 0);
+}
+
+static int vm_cli(int argc, char **argv);
+static int vm_entry(int argc, char **argv);
+
+// WORKER MODE: `vm --worker FD`
+// The shell starts workers ahead of time so exec and dynamic linking are
+// already paid when a program is launched. The worker blocks on the control
+// pipe FD until the shell writes one request and closes its end:
+//   cwd \0 program.bin \0 [flag \0]...
+// then becomes an ordinary `vm program.bin [flags]` process. EOF without a
+// request (the shell exited or drained its pool) just ends the worker.
+// The limits are shared with dispatch_to_worker() in shell.c, which forks +
+// execs instead of sending a request that exceeds them.
+#define WORKER_MSG_MAX 4096
+#define WORKER_MAX_ARGS 512 // `run` with MAX_PROGRAMS ids plus flags
+
+static int worker_main(int fd) {
+    char msg[WORKER_MSG_MAX];
+    size_t len = 0;
+    ssize_t n;
+    while (len < sizeof(msg) && (n = read(fd, msg + len, sizeof(msg) - len)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("[VM] worker read");
+            return 1;
+        }
+        len += n;
+    }
+    close(fd);
+    if (len == 0) return 0; // Never used
+    if (msg[len - 1] != '\0' || len == sizeof(msg)) {
+        fprintf(stderr, "[VM] Malformed worker request\n");
+        return 1;
+    }
+
+    char *argv[WORKER_MAX_ARGS + 2] = { "vm" };
+    int argc = 1;
+    const char *cwd = msg;
+    for (char *p = msg + strlen(msg) + 1; p < msg + len; p += strlen(p) + 1) {
+        if (argc > WORKER_MAX_ARGS) { // Never run a truncated command line
+            fprintf(stderr, "[VM] Worker request has more than %d arguments\n", WORKER_MAX_ARGS);
+            return 1;
+        }
+        argv[argc++] = p;
+    }
+    argv[argc] = NULL;
+    if (chdir(cwd) != 0) {
+        perror("[VM] worker chdir");
+        return 1;
+    }
+    return vm_entry(argc, argv);
+}
+
+static int vm_entry(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "--sched") == 0) return run_sched(argc, argv);
+    return vm_cli(argc, argv);
+}
+
+#ifndef TESTING
+int main(int argc, char **argv) {
+#else
+int run_vm_main(int argc, char **argv) {
+#endif
+    if (argc >= 3 && strcmp(argv[1], "--worker") == 0) return worker_main(atoi(argv[2]));
+    return vm_entry(argc, argv);
+}
+
+static int vm_cli(int argc, char **argv) {
+    if (argc < 2) return 1;
+
+    VM *vm = vm_create();
+    if (!vm) { perror("calloc"); return 1; }
+    if (vm_load(vm, argv[1]) != 0) {
+        vm_destroy(vm);
+        return 1;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--show-trace") == 0) {
+            int rc = vm_show_trace(vm);
+            vm_destroy(vm);
+            return rc;
+        }
+    }
+
+    // Check for JIT flag or Debug flag
+    int use_jit = 0;
+    int jit_cache = 0;
+    int use_verifier = 1;
+    int verify_only = 0;
+    int debug_mode = 0;
+    int trace_entries = 0;
+    int flush_ms = 50;
+    const char *batch_file = NULL;
+    const char *input_file = NULL;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    // Simple arg parsing logic loop
+    for(int i=2; i<argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) batch_file = argv[++i];
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        if (strcmp(argv[i], "--flush-ms") == 0 && i + 1 < argc) flush_ms = atoi(argv[++i]);
+        if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) input_file = argv[++i];
+        if (strcmp(argv[i], "--jit") == 0) use_jit = 1;
+        if (strcmp(argv[i], "--jit-cache") == 0) use_jit = jit_cache = 1;
+        if (strcmp(argv[i], "--debug") == 0) debug_mode = 1;
+        if (strcmp(argv[i], "--no-verify") == 0) use_verifier = 0;
+        if (strcmp(argv[i], "--verify") == 0) verify_only = 1;
+        if (strncmp(argv[i], "--trace", 7) == 0 && (argv[i][7] == '\0' || argv[i][7] == '=')) {
+            // --trace or --trace=N (number of instructions to keep)
+            trace_entries = argv[i][7] == '=' ? atoi(argv[i] + 8) : TRACE_DEFAULT_ENTRIES;
+            if (trace_entries <= 0) trace_entries = TRACE_DEFAULT_ENTRIES;
+        }
+    }
+    if (input_file && vm_set_input(vm, input_file) != 0) {
+        vm_destroy(vm);
+        return 1;
+    }
+    if (trace_entries && vm_set_trace(vm, trace_entries) != 0) {
+        fprintf(stderr, "Trace buffer allocation failed\n");
+        vm_destroy(vm);
+        return 1;
+    }
+
+    // Load-time verification: code that passes runs without per-instruction checks
+    if (use_verifier || verify_only) {
+        VerifyInfo info;
+        vm_verify(vm, &info);
+        if (verify_only || debug_mode) {
+            if (info.ok) printf("[VM] Bytecode verified (max stack depth %d)\n", info.max_depth);
+            else printf("[VM] Bytecode not verified at PC %d: %s\n", info.error_pc, info.error);
+        }
+        if (verify_only) {
+            vm_destroy(vm);
+            return info.ok ? 0 : 1;
+        }
+    }
+
+    if (batch_file) {
+        if (use_jit || debug_mode || trace_entries) {
+            fprintf(stderr, "[VM] --batch cannot be combined with --jit, --debug or --trace\n");
+            vm_destroy(vm);
+            return 1;
+        }
+        int rc = run_batch(vm, batch_file, threads > 0 ? threads : 1);
+        vm_destroy(vm);
+        return rc;
+    }
+
+    int failed = 0;
+    if (use_jit) {
+        printf("Running with JIT...\n");
+        int result;
+        if (vm_run_jit(vm, jit_cache, &result) == 0) {
+            printf("JIT Result: %d\n", result);
+        } else {
+            fprintf(stderr, "JIT Compilation Failed\n");
+            vm_destroy(vm);
+            return 1;
+        }
+    } else {
+        if (debug_mode) {
+            printf("VM running in DEBUG mode. Type 'help' for commands.\n");
+            vm_set_debug(vm);
+        }
+        install_signal_handlers(vm, trace_entries > 0);
+        if (!debug_mode) start_flush_timer(flush_ms);
+        failed = vm_run(vm, 0) == VM_ERROR;
+        stop_flush_timer();
+        signal_vm = NULL;
+
+        int32_t top;
+        if (!failed && vm_top(vm, &top))
+            printf("Top of stack: %d\n", top);
+        else if (!failed)
+            printf("Stack empty\n");
+
+        VMStats st;
+        vm_stats(vm, &st);
+        if (st.gc_runs > 0) {
+            printf("[GC Stats] Runs: %d, Freed: %d, Total GC Time: %.6fs, Max Heap: %d words\n", 
+                st.gc_runs, st.freed_objects, st.gc_time, st.max_heap_used);
+        }
+    }
+
+    vm_destroy(vm);
+    return failed ? 1 : 0;
+}